@@ -0,0 +1,276 @@
+/**
+ * Shared helpers for the on-chain benchmarks: connecting to a local nodeos,
+ * deploying tracelytics.wasm, pushing measured transactions and seeding
+ * fixtures (companies, sites, products, items).
+ *
+ * Environment:
+ *   NODEOS_URL   (default http://127.0.0.1:8888)
+ *   CONTRACT     (default tracelytics)
+ *   PRIVATE_KEY  (default: the well-known local development key)
+ **/
+const fs = require('fs')
+const path = require('path')
+const crypto = require('crypto')
+const fetch = require('node-fetch')
+const { TextEncoder, TextDecoder } = require('util')
+const { Api, JsonRpc, Serialize } = require('eosjs')
+const { JsSignatureProvider } = require('eosjs/dist/eosjs-jssig')
+
+const DEV_KEY = '5KQwrPbwdL6PhXujxW37FSSQZ1JiwsST4cqQzDeyXtP79zkvFD3'
+const DEV_PUBLIC_KEY = 'EOS6MRyAjQq8ud7hVNYcfnVPJqcVpscN5So8BhtHuGYqET5GDW5CV'
+const ROOT = path.resolve(__dirname, '..', '..')
+
+class Chain {
+  constructor ({
+    endpoint = process.env.NODEOS_URL || 'http://127.0.0.1:8888',
+    contract = process.env.CONTRACT || 'tracelytics',
+    privateKey = process.env.PRIVATE_KEY || DEV_KEY
+  } = {}) {
+    this.endpoint = endpoint
+    this.contract = contract
+    this.rpc = new JsonRpc(endpoint, { fetch })
+    this.api = new Api({
+      rpc: this.rpc,
+      signatureProvider: new JsSignatureProvider([privateKey]),
+      textDecoder: new TextDecoder(),
+      textEncoder: new TextEncoder()
+    })
+    this.run = Date.now().toString(36)
+    this.counters = {}
+  }
+
+  // Unique per-run identifiers, so repeated runs never collide with old rows
+  id (kind) {
+    this.counters[kind] = (this.counters[kind] || 0) + 1
+    return `${kind}-${this.run}-${this.counters[kind]}`
+  }
+
+  static timestamp (offsetSeconds = 0) {
+    return new Date(Date.UTC(2020, 0, 1) + offsetSeconds * 1000).toISOString().slice(0, -1)
+  }
+
+  static map (n, prefix = 'k') {
+    return Array.from({ length: n }, (_, i) => ({ key: `${prefix}${i}`, value: `value-${i}` }))
+  }
+
+  action (name, data) {
+    return {
+      account: this.contract,
+      name,
+      authorization: [{ actor: this.contract, permission: 'active' }],
+      data
+    }
+  }
+
+  // Deploy
+  async ensureAccount () {
+    try {
+      await this.rpc.get_account(this.contract)
+      return
+    } catch (e) {}
+
+    const authority = { threshold: 1, keys: [{ key: DEV_PUBLIC_KEY, weight: 1 }], accounts: [], waits: [] }
+    await this.api.transact({
+      actions: [{
+        account: 'eosio',
+        name: 'newaccount',
+        authorization: [{ actor: 'eosio', permission: 'active' }],
+        data: { creator: 'eosio', name: this.contract, owner: authority, active: authority }
+      }]
+    }, { blocksBehind: 3, expireSeconds: 30 })
+  }
+
+  async deploy ({
+    wasm = path.join(ROOT, 'tracelytics.wasm'),
+    abi = path.join(ROOT, 'tracelytics.abi')
+  } = {}) {
+    await this.ensureAccount()
+
+    const wasmHex = fs.readFileSync(wasm).toString('hex')
+    this.wasmHash = crypto.createHash('sha256').update(fs.readFileSync(wasm)).digest('hex')
+
+    const buffer = new Serialize.SerialBuffer({ textEncoder: this.api.textEncoder, textDecoder: this.api.textDecoder })
+    const abiDefinition = this.api.abiTypes.get('abi_def')
+    const abiJSON = abiDefinition.fields.reduce(
+      (acc, { name }) => Object.assign(acc, { [name]: acc[name] || [] }),
+      JSON.parse(fs.readFileSync(abi, 'utf8'))
+    )
+    abiDefinition.serialize(buffer, abiJSON)
+
+    const auth = [{ actor: this.contract, permission: 'active' }]
+    const actions = [
+      { account: 'eosio', name: 'setcode', authorization: auth, data: { account: this.contract, vmtype: 0, vmversion: 0, code: wasmHex } },
+      { account: 'eosio', name: 'setabi', authorization: auth, data: { account: this.contract, abi: Buffer.from(buffer.asUint8Array()).toString('hex') } },
+      // Inline actions are sent with the contract's active permission
+      {
+        account: 'eosio',
+        name: 'updateauth',
+        authorization: auth,
+        data: {
+          account: this.contract,
+          permission: 'active',
+          parent: 'owner',
+          auth: {
+            threshold: 1,
+            keys: [{ key: DEV_PUBLIC_KEY, weight: 1 }],
+            accounts: [{ permission: { actor: this.contract, permission: 'eosio.code' }, weight: 1 }],
+            waits: []
+          }
+        }
+      }
+    ]
+
+    try {
+      await this.api.transact({ actions }, { blocksBehind: 3, expireSeconds: 30 })
+    } catch (e) {
+      // Setting identical code is rejected; anything else is a real failure
+      if (!/contract is already running this version of code/.test(e.message)) throw e
+      await this.api.transact({ actions: actions.slice(1) }, { blocksBehind: 3, expireSeconds: 30 })
+    }
+    // Refresh the cached ABI
+    this.api.cachedAbis.delete(this.contract)
+  }
+
+  async ramUsage () {
+    const account = await this.rpc.get_account(this.contract)
+    return account.ram_usage
+  }
+
+  /**
+   * Pushes one contract action in its own transaction and returns its billed
+   * CPU, NET and RAM. Inline actions it caused (logbatch, editprocess,
+   * edititem, ...) are attributed to it and broken down by name.
+   *
+   * options.maxCpuMs caps the transaction's CPU (max_cpu_usage_ms).
+   **/
+  async measure (name, data, { maxCpuMs = 0 } = {}) {
+    const ramBefore = await this.ramUsage()
+    const started = Date.now()
+    let result
+    try {
+      result = await this.api.transact(
+        { max_cpu_usage_ms: maxCpuMs, actions: [this.action(name, data)] },
+        { blocksBehind: 3, expireSeconds: 30 }
+      )
+    } catch (e) {
+      return { ok: false, error: errorMessage(e), latency_ms: Date.now() - started }
+    }
+    const ramAfter = await this.ramUsage()
+    const { receipt, action_traces: traces } = result.processed
+
+    return {
+      ok: true,
+      transaction_id: result.transaction_id,
+      cpu_us: receipt.cpu_usage_us,
+      net_bytes: receipt.net_usage_words * 8,
+      ram_bytes: ramAfter - ramBefore,
+      latency_ms: Date.now() - started,
+      ...attribute(traces)
+    }
+  }
+
+  // Unmeasured setup, batched several actions per transaction
+  async setup (actions, batch = 20) {
+    for (let i = 0; i < actions.length; i += batch) {
+      await this.api.transact(
+        { actions: actions.slice(i, i + batch).map(({ name, data }) => this.action(name, data)) },
+        { blocksBehind: 3, expireSeconds: 30 }
+      )
+    }
+  }
+
+  // Fixtures
+  async company () {
+    const company = this.id('company')
+    await this.setup([{ name: 'newcompany', data: { ...Fixtures.company(company), user: 'bench', company } }])
+    return company
+  }
+
+  async site (company, tracked = true) {
+    const site = this.id('site')
+    await this.setup([{ name: 'newsite', data: { ...Fixtures.site(site, company, tracked), user: 'bench', company } }])
+    return site
+  }
+
+  async items (company, site, n, quantity = 10) {
+    const items = Array.from({ length: n }, () => this.id('item'))
+    await this.setup(items.map(itemId => ({
+      name: 'newitem',
+      data: Fixtures.item(company, site, itemId, 'widget', quantity)
+    })))
+    return items
+  }
+}
+
+// Action argument builders with every optional field left empty
+const Fixtures = {
+  company: (companyId, data = []) => ({
+    companyId, name: companyId, timestamp: Chain.timestamp(), data,
+    legalName: null, country: null, contact: null, phone: null, email: null, fax: null,
+    customerSince: null, currentClient: null, status: null, description: null, version: null
+  }),
+  site: (siteId, siteCompany, tracked, data = []) => ({
+    siteId, siteCompany, tracked, timestamp: Chain.timestamp(), data,
+    name: null, address: null, contact: null, description: null, version: null
+  }),
+  item: (company, site, itemId, product, quantity, metadata = []) => ({
+    user: 'bench', company, site, itemId, product, quantity, metadata,
+    action: 'newitem', actionId: itemId, timestamp: Chain.timestamp(), data: [], version: null
+  }),
+  cargo: (items, quantity = 10) => items.map(item => ({
+    key: item, value: { product: 'widget', quantity, metadata: [] }
+  }))
+}
+
+function attribute (traces = []) {
+  const inline = {}
+  let elapsed = 0
+
+  const visit = (trace, depth) => {
+    if (depth > 0) {
+      const name = trace.act.name
+      inline[name] = inline[name] || { count: 0, elapsed_us: 0 }
+      inline[name].count += 1
+      inline[name].elapsed_us += trace.elapsed || 0
+    } else {
+      elapsed += trace.elapsed || 0
+    }
+    for (const child of trace.inline_traces || []) visit(child, depth + 1)
+  }
+
+  // Nested (legacy) traces carry inline_traces; flat ones carry creator_action_ordinal
+  const nested = traces.some(t => Array.isArray(t.inline_traces) && t.inline_traces.length)
+  if (nested || traces.every(t => t.creator_action_ordinal === undefined)) {
+    traces.forEach(t => visit(t, 0))
+  } else {
+    traces.forEach(t => visit({ ...t, inline_traces: [] }, t.creator_action_ordinal > 0 ? 1 : 0))
+  }
+
+  return { elapsed_us: elapsed, inline }
+}
+
+function errorMessage (e) {
+  const details = e && e.json && e.json.error && e.json.error.details
+  if (details && details.length) return details.map(d => d.message).join('; ')
+  return (e && e.message) || String(e)
+}
+
+function writeReport (file, report) {
+  fs.mkdirSync(path.dirname(file), { recursive: true })
+  fs.writeFileSync(file, JSON.stringify(report, null, 2))
+}
+
+function parseArgs (argv, defaults) {
+  const options = { ...defaults }
+  for (const arg of argv) {
+    const [key, value] = arg.replace(/^--/, '').split('=')
+    if (!(key in defaults)) throw new Error(`unknown option --${key}`)
+    options[key] = Array.isArray(defaults[key]) ? value.split(',').map(Number)
+      : typeof defaults[key] === 'number' ? Number(value)
+      : typeof defaults[key] === 'boolean' ? value !== 'false'
+      : value
+  }
+  return options
+}
+
+module.exports = { Chain, Fixtures, attribute, errorMessage, writeReport, parseArgs, ROOT }
@@ -0,0 +1,478 @@
+/**
+ * Per-action CPU/NET/RAM cost matrix against a local nodeos.
+ *
+ * Deploys tracelytics.wasm, then runs every action in contract.hpp at each
+ * payload size (cargo lines, process inputs/outputs, metadata/data entries,
+ * permission vector length, table rows) and writes the billed CPU µs, NET
+ * bytes and RAM delta of each to a JSON report. Inline actions are counted
+ * against the action that sent them.
+ *
+ * Usage: node bench/chain/costmatrix.js [--sizes=1,10,50,100] [--only=newdelivery,editprocess]
+ *                                       [--out=bench/chain/reports/costmatrix.json] [--deploy=false]
+ **/
+const path = require('path')
+const { Chain, Fixtures, writeReport, parseArgs, ROOT } = require('./chain')
+
+const Scenarios = [
+  // Companies, sites, products, machines: size = data entries
+  {
+    action: 'newcompany', dimension: 'data entries',
+    run: async (chain, n) => {
+      const company = chain.id('company')
+      return { ...Fixtures.company(company, Chain.map(n)), user: 'bench', company }
+    }
+  },
+  {
+    action: 'editcompany', dimension: 'data entries',
+    run: async (chain, n) => {
+      const company = await chain.company()
+      return { ...Fixtures.company(company, Chain.map(n)), user: 'bench', company }
+    }
+  },
+  {
+    action: 'delcompany', dimension: 'fixed', fixed: true,
+    run: async (chain) => {
+      const company = await chain.company()
+      return { user: 'admin', company, companyId: company, timestamp: Chain.timestamp() }
+    }
+  },
+  {
+    action: 'newsite', dimension: 'data entries',
+    run: async (chain, n) => {
+      const company = await chain.company()
+      return { ...Fixtures.site(chain.id('site'), company, true, Chain.map(n)), user: 'bench', company }
+    }
+  },
+  {
+    action: 'editsite', dimension: 'data entries',
+    run: async (chain, n) => {
+      const company = await chain.company()
+      const site = await chain.site(company)
+      return { ...Fixtures.site(site, company, true, Chain.map(n)), user: 'bench', company }
+    }
+  },
+  {
+    action: 'delsite', dimension: 'fixed', fixed: true,
+    run: async (chain) => {
+      const company = await chain.company()
+      const siteId = await chain.site(company)
+      return { user: 'bench', company, siteId, timestamp: Chain.timestamp() }
+    }
+  },
+  {
+    action: 'newproduct', dimension: 'data entries',
+    run: async (chain, n) => product(chain, chain.id('product'), n)
+  },
+  {
+    action: 'editproduct', dimension: 'data entries',
+    run: async (chain, n) => {
+      const productId = chain.id('product')
+      await chain.setup([{ name: 'newproduct', data: product(chain, productId, 0) }])
+      return {
+        user: 'bench', company: 'bench', productId, timestamp: Chain.timestamp(), data: Chain.map(n),
+        name: 'renamed', uom: null, defaultPrice: null, defaultCurrency: null, image: null, description: null, version: null
+      }
+    }
+  },
+  {
+    action: 'delproduct', dimension: 'fixed', fixed: true,
+    run: async (chain) => {
+      const productId = chain.id('product')
+      await chain.setup([{ name: 'newproduct', data: product(chain, productId, 0) }])
+      return { user: 'bench', company: 'bench', productId, timestamp: Chain.timestamp() }
+    }
+  },
+  {
+    action: 'newmachine', dimension: 'data entries',
+    run: async (chain, n) => {
+      const company = await chain.company()
+      const site = await chain.site(company)
+      return machine(company, site, chain.id('machine'), n)
+    }
+  },
+  {
+    action: 'editmachine', dimension: 'data entries',
+    run: async (chain, n) => {
+      const company = await chain.company()
+      const site = await chain.site(company)
+      const machineId = chain.id('machine')
+      await chain.setup([{ name: 'newmachine', data: machine(company, site, machineId, 0) }])
+      return { user: 'bench', company, machineId, timestamp: Chain.timestamp(), data: Chain.map(n), site: null, name: 'renamed', description: null, version: null }
+    }
+  },
+  {
+    action: 'delmachine', dimension: 'fixed', fixed: true,
+    run: async (chain) => {
+      const company = await chain.company()
+      const site = await chain.site(company)
+      const machineId = chain.id('machine')
+      await chain.setup([{ name: 'newmachine', data: machine(company, site, machineId, 0) }])
+      return { user: 'bench', company, machineId, timestamp: Chain.timestamp() }
+    }
+  },
+
+  // Users: size = permission vector length
+  {
+    action: 'newuser', dimension: 'permissions',
+    run: async (chain, n) => user(await chain.company(), chain.id('user'), n)
+  },
+  {
+    action: 'edituser', dimension: 'permissions',
+    run: async (chain, n) => {
+      const company = await chain.company()
+      const userId = chain.id('user')
+      await chain.setup([{ name: 'newuser', data: user(company, userId, 0) }])
+      return user(company, userId, n)
+    }
+  },
+  {
+    action: 'deluser', dimension: 'fixed', fixed: true,
+    run: async (chain) => {
+      const company = await chain.company()
+      const userId = chain.id('user')
+      await chain.setup([{ name: 'newuser', data: user(company, userId, 0) }])
+      return { user: 'bench', company, userId, timestamp: Chain.timestamp() }
+    }
+  },
+
+  // Recipes: size = inputs and outputs
+  {
+    action: 'newrecipe', dimension: 'inputs+outputs',
+    run: async (chain, n) => recipe(await chain.company(), chain.id('recipe'), n)
+  },
+  {
+    action: 'editrecipe', dimension: 'inputs+outputs',
+    run: async (chain, n) => {
+      const company = await chain.company()
+      const recipeId = chain.id('recipe')
+      await chain.setup([{ name: 'newrecipe', data: recipe(company, recipeId, 1) }])
+      return recipe(company, recipeId, n)
+    }
+  },
+  {
+    action: 'delrecipe', dimension: 'fixed', fixed: true,
+    run: async (chain) => {
+      const company = await chain.company()
+      const recipeId = chain.id('recipe')
+      await chain.setup([{ name: 'newrecipe', data: recipe(company, recipeId, 1) }])
+      return { user: 'bench', company, recipeId, timestamp: Chain.timestamp() }
+    }
+  },
+
+  // Items: size = metadata entries
+  {
+    action: 'newitem', dimension: 'metadata entries',
+    run: async (chain, n) => {
+      const company = await chain.company()
+      const site = await chain.site(company)
+      return Fixtures.item(company, site, chain.id('item'), 'widget', 10, Chain.map(n))
+    }
+  },
+  {
+    action: 'edititem', dimension: 'metadata entries',
+    run: async (chain, n) => {
+      const company = await chain.company()
+      const site = await chain.site(company)
+      const [itemId] = await chain.items(company, site, 1)
+      return {
+        user: 'bench', company, site, itemId, metadata: Chain.map(n), action: 'edititem', actionId: itemId,
+        timestamp: Chain.timestamp(), data: [], quantity: null, delta: 1, product: null, delivery: null, version: null
+      }
+    }
+  },
+  {
+    action: 'delitem', dimension: 'fixed', fixed: true,
+    run: async (chain) => {
+      const company = await chain.company()
+      const site = await chain.site(company)
+      const [itemId] = await chain.items(company, site, 1)
+      return { user: 'bench', company, site, itemId, action: 'delitem', actionId: itemId, timestamp: Chain.timestamp() }
+    }
+  },
+
+  // Deliveries: size = cargo lines
+  ...['receive', 'untracked', 'tracked'].map(scenario => ({
+    action: 'newdelivery', scenario, dimension: 'cargo lines',
+    run: async (chain, n) => {
+      const { data } = await delivery(chain, n, { receive: scenario === 'receive', tracked: scenario === 'tracked' })
+      return data
+    }
+  })),
+  {
+    action: 'editdelivery', scenario: 'cargoDeltas', dimension: 'cargo lines',
+    run: async (chain, n) => {
+      const { data, fromCompany, fromSite } = await delivery(chain, 1)
+      await chain.setup([{ name: 'newdelivery', data }])
+      const items = await chain.items(fromCompany, fromSite, n)
+      return editDelivery(data, { cargoDeltas: Fixtures.cargo(items) })
+    }
+  },
+  {
+    action: 'editdelivery', scenario: 'deliver', dimension: 'cargo lines',
+    run: async (chain, n) => {
+      const { data } = await delivery(chain, n)
+      await chain.setup([{ name: 'newdelivery', data }])
+      return editDelivery(data, { status: 'delivered' })
+    }
+  },
+  {
+    action: 'deldelivery', scenario: 'cancel', dimension: 'cargo lines',
+    run: async (chain, n) => {
+      const { data } = await delivery(chain, n)
+      await chain.setup([{ name: 'newdelivery', data }])
+      return { user: 'bench', company: data.company, deliveryId: data.deliveryId, route: data.route, timestamp: Chain.timestamp(), cancel: true }
+    }
+  },
+
+  // Processes: size = input lines (and as many output lines)
+  ...['process', 'split', 'merge'].map(type => ({
+    action: 'newprocess', scenario: type, dimension: 'inputs+outputs',
+    run: async (chain, n) => (await newProcess(chain, n, type)).data
+  })),
+  {
+    action: 'editprocess', scenario: 'inputDeltas', dimension: 'input lines',
+    run: async (chain, n) => {
+      const { data, company, site } = await newProcess(chain, 1, 'process')
+      await chain.setup([{ name: 'newprocess', data }])
+      const items = await chain.items(company, site, n)
+      return editProcess(data, { inputDeltas: Fixtures.cargo(items, 1) })
+    }
+  },
+  {
+    action: 'editprocess', scenario: 'finish', dimension: 'output lines',
+    run: async (chain, n) => {
+      const { data } = await newProcess(chain, n, 'process')
+      await chain.setup([{ name: 'newprocess', data }])
+      return editProcess(data, { status: 'processed' })
+    }
+  },
+  {
+    action: 'delprocess', scenario: 'cancel', dimension: 'input lines',
+    run: async (chain, n) => {
+      const { data } = await newProcess(chain, n, 'process')
+      await chain.setup([{ name: 'newprocess', data }])
+      return { user: 'bench', company: data.company, processId: data.processId, timestamp: Chain.timestamp(), cancel: true }
+    }
+  },
+
+  // Logs: size = log rows examined (every fixture is logged in the 202001 partition)
+  {
+    action: 'rolluplog', dimension: 'log rows',
+    run: async (chain, n) => {
+      const company = await chain.company()
+      await chain.items(company, await chain.site(company), n)
+      return { cutoff: Chain.timestamp(86400), max_rows: n }
+    }
+  },
+  {
+    action: 'droplogs', dimension: 'log rows',
+    run: async (chain, n) => {
+      const company = await chain.company()
+      await chain.items(company, await chain.site(company), n)
+      return { period: 202001, max_rows: n }
+    }
+  },
+
+  // Jobs: size = cargo lines left to the job (receiving moves the first JOB_INLINE_STEPS itself)
+  {
+    action: 'crank', dimension: 'cargo lines',
+    run: async (chain, n) => {
+      const { data } = await delivery(chain, n + JOB_INLINE_STEPS)
+      await chain.setup([{ name: 'newdelivery', data }, { name: 'editdelivery', data: editDelivery(data, { status: 'delivered' }) }])
+      const { rows: [job] } = await chain.rpc.get_table_rows({ code: chain.contract, scope: chain.contract, table: 'job', reverse: true, limit: 1 })
+      return { max_steps: n, job: job.index }
+    }
+  },
+
+  // Maintenance: size = rows erased, max_rows (clearall wipes the fixtures, so it runs last)
+  {
+    action: 'cleartable', scenario: 'item', dimension: 'rows erased',
+    run: async (chain, n) => {
+      await clearFully(chain, 'cleartable', { tableName: 'item' }, JobType.CLEAR_TABLE)
+      const company = await chain.company()
+      await chain.items(company, await chain.site(company), n)
+      return { tableName: 'item', max_rows: n }
+    }
+  },
+  {
+    action: 'purgecompany', dimension: 'rows erased',
+    run: async (chain, n) => {
+      const company = await chain.company()
+      await chain.items(company, await chain.site(company), n)
+      return { company, max_rows: n }
+    }
+  },
+  {
+    action: 'clearall', dimension: 'rows erased',
+    run: async (chain, n) => {
+      await clearFully(chain, 'clearall', {}, JobType.CLEAR_ALL)
+      const company = await chain.company()
+      await chain.items(company, await chain.site(company), n)
+      return { max_rows: n }
+    }
+  }
+]
+
+// Job types and the steps a job's own action takes, as in the contract (types.hpp, contract.hpp)
+const JobType = { CLEAR_TABLE: 4, CLEAR_ALL: 5 }
+const JOB_PENDING = 1
+const JOB_INLINE_STEPS = 100
+
+// Runs a clearing action until no job of its type is pending, so the measured call starts on a clean table
+async function clearFully (chain, name, data, type, batch = 500) {
+  for (;;) {
+    await chain.setup([{ name, data: { ...data, max_rows: batch } }])
+    const { rows } = await chain.rpc.get_table_rows({ code: chain.contract, scope: chain.contract, table: 'job', limit: 1000 })
+    if (!rows.some(job => job.type === type && job.status === JOB_PENDING)) return
+  }
+}
+
+// Actions deliberately left out of the matrix
+const Skipped = {
+  push: 'requires a user-signed payload and has no effect beyond verify_auth',
+  logbatch: 'only built with TRACELYTICS_LOG_NOTIFY, and measured as an inline action of the actions that log'
+}
+
+function product (chain, productId, n) {
+  return {
+    user: 'bench', company: 'bench', productId, name: productId, uom: 'unit', defaultPrice: 1, defaultCurrency: 'USD',
+    timestamp: Chain.timestamp(), data: Chain.map(n), image: null, description: null, version: null
+  }
+}
+
+function machine (company, site, machineId, n) {
+  return { user: 'bench', company, machineId, site, timestamp: Chain.timestamp(), data: Chain.map(n), name: null, description: null, version: null }
+}
+
+function user (company, userId, n) {
+  return {
+    user: 'bench', company, userId,
+    permissions: Array.from({ length: n }, (_, i) => `entity${i};create`),
+    certifications: [], timestamp: Chain.timestamp(), data: [],
+    key: null, firstName: null, lastName: null, email: null, phone: null, description: null, version: null
+  }
+}
+
+function recipe (company, recipeId, n) {
+  const lines = Array.from({ length: n }, (_, i) => ({ product: `product-${i}`, quantity: 1, metadata: [] }))
+  return {
+    user: 'bench', company, recipeId, inputs: lines, outputs: lines, timestamp: Chain.timestamp(), data: [],
+    name: null, description: null, version: null
+  }
+}
+
+async function delivery (chain, n, { receive = false, tracked = true } = {}) {
+  const fromCompany = await chain.company()
+  const toCompany = await chain.company()
+  const fromSite = await chain.site(fromCompany)
+  const toSite = await chain.site(toCompany, tracked)
+  const items = receive
+    ? Array.from({ length: n }, () => chain.id('item'))
+    : await chain.items(fromCompany, fromSite, n)
+
+  const data = {
+    user: 'bench',
+    company: fromCompany,
+    deliveryId: chain.id('delivery'),
+    route: '',
+    fromSite,
+    toSite,
+    fromCompany,
+    toCompany,
+    startTime: Chain.timestamp(),
+    type: receive ? 'Receive Delivery' : 'Send Delivery',
+    cargo: Fixtures.cargo(items),
+    timestamp: Chain.timestamp(),
+    data: [],
+    endTime: null, shipper: null, driver: null, status: null, description: null, version: null
+  }
+  return { data, fromCompany, fromSite, toCompany, toSite }
+}
+
+function editDelivery (created, { cargoDeltas = [], status = null }) {
+  return {
+    user: 'bench', company: created.company, deliveryId: created.deliveryId, route: created.route,
+    cargoDeltas, timestamp: Chain.timestamp(1), data: [],
+    toSite: null, toCompany: null, startTime: null, endTime: null, shipper: null, driver: null,
+    status, description: null, version: null
+  }
+}
+
+async function newProcess (chain, n, type) {
+  const company = await chain.company()
+  const site = await chain.site(company)
+  const items = await chain.items(company, site, n)
+  const outputs = Array.from({ length: n }, () => chain.id('item'))
+
+  const data = {
+    user: 'bench', company, processId: chain.id('process'), type, site, startTime: Chain.timestamp(),
+    inputs: Fixtures.cargo(items), outputs: Fixtures.cargo(outputs), timestamp: Chain.timestamp(), data: [],
+    endTime: null, machine: null, status: null, description: null, version: null
+  }
+  return { data, company, site }
+}
+
+function editProcess (created, { inputDeltas = [], outputDeltas = [], status = null }) {
+  return {
+    user: 'bench', company: created.company, processId: created.processId, inputDeltas, outputDeltas,
+    timestamp: Chain.timestamp(1), data: [], startTime: null, endTime: null, machine: null,
+    status, description: null, version: null
+  }
+}
+
+async function main () {
+  const options = parseArgs(process.argv.slice(2), {
+    sizes: [1, 10, 50, 100, 250],
+    only: '',
+    out: path.join(ROOT, 'bench', 'chain', 'reports', `costmatrix-${Date.now()}.json`),
+    deploy: true
+  })
+  const only = options.only ? options.only.split(',') : null
+
+  const chain = new Chain()
+  if (options.deploy) await chain.deploy()
+
+  const report = {
+    kind: 'costmatrix',
+    endpoint: chain.endpoint,
+    contract: chain.contract,
+    wasm_sha256: chain.wasmHash || null,
+    started_at: new Date().toISOString(),
+    skipped: Skipped,
+    results: []
+  }
+
+  for (const scenario of Scenarios) {
+    if (only && !only.includes(scenario.action)) continue
+    const sizes = scenario.fixed ? [1] : options.sizes
+
+    for (const size of sizes) {
+      let row
+      try {
+        const data = await scenario.run(chain, size)
+        row = await chain.measure(scenario.action, data)
+      } catch (e) {
+        row = { ok: false, error: `setup failed: ${e.message}` }
+      }
+      report.results.push({ action: scenario.action, scenario: scenario.scenario || null, dimension: scenario.dimension, size, ...row })
+
+      const label = `${scenario.action}${scenario.scenario ? `/${scenario.scenario}` : ''}`
+      console.log(row.ok
+        ? `${label.padEnd(28)} ${String(size).padStart(6)}  cpu ${String(row.cpu_us).padStart(7)}µs  net ${String(row.net_bytes).padStart(7)}B  ram ${String(row.ram_bytes).padStart(8)}B`
+        : `${label.padEnd(28)} ${String(size).padStart(6)}  FAILED ${row.error}`)
+    }
+  }
+
+  report.finished_at = new Date().toISOString()
+  writeReport(options.out, report)
+  console.log(`report written to ${options.out}`)
+}
+
+if (require.main === module) {
+  main().catch(e => {
+    console.error(e)
+    process.exit(1)
+  })
+}
+
+module.exports = { Scenarios, delivery, editDelivery, newProcess, editProcess }
@@ -0,0 +1,142 @@
+/**
+ * Capacity envelope finder: for each cargo-bearing action, the largest number
+ * of lines that still fits under a transaction CPU limit.
+ *
+ * Every probe seeds fresh fixtures and pushes the action with
+ * max_cpu_usage_ms set to the limit. Sizes double until a probe runs out of
+ * CPU, then a binary search narrows down the last size that fits.
+ *
+ * The report maps "action/scenario" to the maximum line count and a batch
+ * size with --safety headroom applied, ready for client-side batching rules.
+ *
+ * Usage: node bench/chain/envelope.js [--cpu=30] [--max=8192] [--safety=0.8] [--trials=1]
+ *                                     [--only=newdelivery,cleartable] [--out=...] [--deploy=false]
+ **/
+const path = require('path')
+const { Chain, writeReport, parseArgs, ROOT } = require('./chain')
+const { Scenarios } = require('./costmatrix')
+
+const Envelopes = [
+  ['newdelivery', 'receive'],
+  ['newdelivery', 'untracked'],
+  ['newdelivery', 'tracked'],
+  ['editdelivery', 'cargoDeltas'],
+  ['deldelivery', 'cancel'],
+  ['newprocess', 'process'],
+  ['newprocess', 'split'],
+  ['newprocess', 'merge'],
+  ['editprocess', 'inputDeltas'],
+  ['editprocess', 'finish'],
+  ['cleartable', 'item']
+].map(([action, scenario]) => Scenarios.find(s => s.action === action && s.scenario === scenario))
+
+const CPU_EXCEEDED = /tx_cpu_usage_exceeded|deadline_exception|leeway_deadline|billed CPU time|executing for too long|max_cpu_usage/i
+
+async function probe (chain, scenario, lines, options) {
+  let worst = null
+  for (let trial = 0; trial < options.trials; trial++) {
+    const data = await scenario.run(chain, lines)
+    const result = await chain.measure(scenario.action, data, { maxCpuMs: options.cpu })
+    if (!result.ok) {
+      if (!CPU_EXCEEDED.test(result.error)) throw new Error(`${scenario.action} failed at ${lines} lines: ${result.error}`)
+      return { fits: false, error: result.error }
+    }
+    if (!worst || result.cpu_us > worst.cpu_us) worst = result
+  }
+  return { fits: true, cpu_us: worst.cpu_us, net_bytes: worst.net_bytes, ram_bytes: worst.ram_bytes }
+}
+
+async function envelope (chain, scenario, options) {
+  const probes = []
+  const check = async lines => {
+    const result = await probe(chain, scenario, lines, options)
+    probes.push({ lines, ...result })
+    console.log(`  ${String(lines).padStart(6)} lines: ${result.fits ? `${result.cpu_us}µs` : 'over limit'}`)
+    return result
+  }
+
+  // Grow until the first failure (or the ceiling)
+  let fits = 0
+  let fitsResult = null
+  let fails = null
+  for (let lines = 1; lines <= options.max; lines *= 2) {
+    const result = await check(lines)
+    if (!result.fits) { fails = lines; break }
+    fits = lines
+    fitsResult = result
+  }
+  if (fails === null) {
+    return { max_lines: fits, capped: true, cpu_us: fitsResult && fitsResult.cpu_us, probes }
+  }
+
+  // Last size that fits lies in [fits, fails)
+  while (fails - fits > 1) {
+    const mid = Math.floor((fits + fails) / 2)
+    const result = await check(mid)
+    if (result.fits) {
+      fits = mid
+      fitsResult = result
+    } else {
+      fails = mid
+    }
+  }
+  return { max_lines: fits, capped: false, cpu_us: fitsResult ? fitsResult.cpu_us : null, probes }
+}
+
+async function main () {
+  const options = parseArgs(process.argv.slice(2), {
+    cpu: 30,
+    max: 8192,
+    safety: 0.8,
+    trials: 1,
+    only: '',
+    out: path.join(ROOT, 'bench', 'chain', 'reports', `envelope-${Date.now()}.json`),
+    deploy: true
+  })
+  if (options.cpu < 1 || options.cpu > 255) throw new Error('--cpu must be 1-255 ms (max_cpu_usage_ms is a uint8)')
+  const only = options.only ? options.only.split(',') : null
+
+  const chain = new Chain()
+  if (options.deploy) await chain.deploy()
+
+  const report = {
+    kind: 'envelope',
+    endpoint: chain.endpoint,
+    contract: chain.contract,
+    wasm_sha256: chain.wasmHash || null,
+    cpu_limit_ms: options.cpu,
+    safety: options.safety,
+    started_at: new Date().toISOString(),
+    limits: {},
+    results: []
+  }
+
+  for (const scenario of Envelopes) {
+    if (only && !only.includes(scenario.action)) continue
+    const label = `${scenario.action}/${scenario.scenario}`
+    console.log(label)
+
+    const result = await envelope(chain, scenario, options)
+    const batch = Math.max(1, Math.floor(result.max_lines * options.safety))
+    report.limits[label] = { max_lines: result.max_lines, batch_lines: batch, capped: result.capped }
+    report.results.push({ action: scenario.action, scenario: scenario.scenario, dimension: scenario.dimension, ...result, batch_lines: batch })
+  }
+
+  console.log(`\n${'action'.padEnd(28)} ${'max lines'.padStart(10)} ${'batch'.padStart(8)}  (cpu limit ${options.cpu}ms)`)
+  for (const [label, { max_lines: max, batch_lines: batch, capped }] of Object.entries(report.limits)) {
+    console.log(`${label.padEnd(28)} ${String(max).padStart(10)}${capped ? '+' : ' '}${String(batch).padStart(8)}`)
+  }
+
+  report.finished_at = new Date().toISOString()
+  writeReport(options.out, report)
+  console.log(`report written to ${options.out}`)
+}
+
+if (require.main === module) {
+  main().catch(e => {
+    console.error(e)
+    process.exit(1)
+  })
+}
+
+module.exports = { Envelopes, envelope }
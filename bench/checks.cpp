@@ -0,0 +1,513 @@
+/**
+ * Host-side behavior checks for the actions the benchmarks drive
+ *
+ *  - split children of partial sends and their names
+ *  - balance and in-transit rows through send, receive and cancel
+ *  - jobs that fail, and resume when cranked by index or started again
+ *  - rolluplog resuming from its cursor
+ *  - purgecompany and cleartable leaving consistent tables
+ *
+ * Each check seeds a fresh in-memory database and runs the actions one at a
+ * time, as separate transactions (inline actions drained after each).
+ *
+ * Usage: checks [name ...]   (all checks by default; exits non-zero on a failure)
+ **/
+#include "tracelytics/tracelytics.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace {
+  struct check_failure : std::exception {
+    std::string message;
+    explicit check_failure(std::string m) : message(std::move(m)) {}
+    const char* what() const noexcept override { return message.c_str(); }
+  };
+
+  void expect(bool condition, const std::string& message) {
+    if (!condition) throw check_failure(message);
+  }
+
+  std::string str(double value) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%g", value);
+    return buf;
+  }
+}
+
+struct tracelytics_checks {
+  using Item = tracelytics::Item;
+
+  const eosio::name self = "tracelytics"_n;
+  const std::string user    = "checks";
+  const std::string product = "widget";
+  std::map<std::string, std::string> data;
+
+  tracelytics contract() const {
+    return tracelytics(self, self, datastream<const char*>(nullptr, 0));
+  }
+
+  static time_point at(int64_t seconds) {
+    return time_point(eosio::seconds(1577836800 + seconds));
+  }
+
+  // Runs one action as its own transaction: the contract object (and with it the
+  // balance and key writes of its destructor) is gone before the inline actions run
+  void act(const std::function<void(tracelytics&)>& action) const {
+    {
+      auto c = contract();
+      action(c);
+    }
+    native::drain();
+  }
+
+  void reset() const {
+    native::reset();
+    native::set_transaction(std::vector<char>(256, 'x'));
+  }
+
+  void company(const std::string& company, const std::vector<std::string>& sites) const {
+    act([&](auto& c) {
+      c.newcompany(user, company, company, company, at(0), data,
+                   std::nullopt, std::nullopt, std::nullopt, std::nullopt, std::nullopt, std::nullopt,
+                   std::nullopt, std::nullopt, std::nullopt, std::nullopt, std::nullopt);
+      for (const auto& site : sites) {
+        c.newsite(user, company, site, company, true, at(0), data,
+                  std::nullopt, std::nullopt, std::nullopt, std::nullopt, std::nullopt);
+      }
+    });
+  }
+
+  void items(const std::string& company, const std::string& site, const std::vector<std::pair<std::string, double>>& items) const {
+    act([&](auto& c) {
+      for (const auto& [itemId, quantity] : items) {
+        c.newitem(user, company, site, itemId, product, quantity, {}, Actions::NEW_ITEM, itemId, at(0), data, std::nullopt);
+      }
+    });
+  }
+
+  static CargoLines cargo(const std::vector<std::pair<std::string, double>>& lines, const std::string& product = "widget") {
+    CargoLines result;
+    for (const auto& [itemId, quantity] : lines) {
+      ProductQuantity pq;
+      pq.product  = product;
+      pq.quantity = quantity;
+      result.emplace_back(itemId, pq);
+    }
+    return result;
+  }
+
+  void send(const std::string& deliveryId, const std::string& from, const std::string& fromSite,
+            const std::string& to, const std::string& toSite, const std::vector<std::pair<std::string, double>>& lines) const {
+    act([&](auto& c) {
+      auto sent = cargo(lines);
+      c.newdelivery(user, from, deliveryId, "", fromSite, toSite, from, to, at(1), "Send Delivery", sent, at(1), data,
+                    std::nullopt, std::nullopt, std::nullopt, std::nullopt, std::nullopt, std::nullopt);
+    });
+  }
+
+  void edit_cargo(const std::string& company, const std::string& deliveryId, const std::vector<std::pair<std::string, double>>& lines) const {
+    act([&](auto& c) {
+      auto deltas = cargo(lines);
+      c.editdelivery(user, company, deliveryId, "", deltas, at(2), data,
+                     std::nullopt, std::nullopt, std::nullopt, std::nullopt, std::nullopt, std::nullopt, std::nullopt, std::nullopt, std::nullopt);
+    });
+  }
+
+  void receive(const std::string& by, const std::string& company, const std::string& deliveryId) const {
+    act([&](auto& c) {
+      CargoLines none;
+      c.editdelivery(by, company, deliveryId, "", none, at(3), data,
+                     std::nullopt, std::nullopt, std::nullopt, std::nullopt, std::nullopt, std::nullopt,
+                     std::string("delivered"), std::nullopt, std::nullopt);
+    });
+  }
+
+  void cancel(const std::string& company, const std::string& deliveryId) const {
+    act([&](auto& c) { c.deldelivery(user, company, deliveryId, "", at(3), true); });
+  }
+
+  // Runs every pending job to the end
+  void crank_all() const {
+    for (int i = 0; i < 1000 && pending_jobs() > 0; ++i) {
+      act([&](auto& c) { c.crank(1000, std::nullopt); });
+    }
+    expect(pending_jobs() == 0, "jobs still pending after cranking");
+  }
+
+  std::size_t pending_jobs() const {
+    auto c = contract();
+    std::size_t pending = 0;
+    for (const auto& job : c._jobs) pending += job.status == JobStatus::PENDING;
+    return pending;
+  }
+
+  const tracelytics::Job& job(tracelytics& c, uint8_t type) const {
+    for (const auto& job : c._jobs) {
+      if (job.type == type) return job;
+    }
+    throw check_failure("no job of type " + std::to_string(type));
+  }
+
+  std::string item_field(const std::string& itemId, std::function<std::string(const Item&)> field) const {
+    auto c = contract();
+    for (const auto& item : c._items) {
+      if (item.itemId == itemId) return field(item);
+    }
+    return "(none)";
+  }
+
+  double quantity(const std::string& itemId) const {
+    auto c = contract();
+    for (const auto& item : c._items) {
+      if (item.itemId == itemId) return item.quantity;
+    }
+    return -1;
+  }
+
+  std::string delivery_status(const std::string& deliveryId) const {
+    auto c = contract();
+    for (const auto& delivery : c._deliveries) {
+      if (delivery.deliveryId == deliveryId) return std::string(delivery.status_name());
+    }
+    return "(none)";
+  }
+
+  /**
+   * Balance and in-transit rows match the items they count, none is left at zero and there is
+   * at most one row per balance
+   **/
+  void expect_balances_consistent() const {
+    auto c = contract();
+    std::map<std::tuple<std::string, std::string, std::string>, double> balances;
+    std::map<std::tuple<std::string, std::string>, double> inTransit;
+    for (const auto& item : c._items) {
+      if (item.delivery.empty()) {
+        balances[{ item.company, item.site, item.product }] += item.quantity;
+      } else {
+        inTransit[{ item.company, item.product }] += item.quantity;
+      }
+    }
+
+    std::size_t rows = 0;
+    for (const auto& row : c._balances) {
+      ++rows;
+      const auto expected = balances.find({ row.company, row.site, row.product });
+      const double quantity = expected == balances.end() ? 0 : expected->second;
+      expect(row.quantity != 0, "balance row of " + row.site + " left at zero");
+      expect(std::abs(row.quantity - quantity) < 1e-9, "balance of " + row.site + " is " + str(row.quantity) + ", items hold " + str(quantity));
+    }
+    std::size_t expected = 0;
+    for (const auto& [key, quantity] : balances) expected += std::abs(quantity) > 1e-9;
+    expect(rows == expected, "balance has " + std::to_string(rows) + " rows, items need " + std::to_string(expected));
+
+    rows = 0;
+    for (const auto& row : c._in_transit) {
+      ++rows;
+      const auto expected = inTransit.find({ row.company, row.product });
+      const double quantity = expected == inTransit.end() ? 0 : expected->second;
+      expect(row.quantity != 0, "in-transit row of " + row.company + " left at zero");
+      expect(std::abs(row.quantity - quantity) < 1e-9, "in transit " + row.company + " is " + str(row.quantity) + ", items hold " + str(quantity));
+    }
+    expected = 0;
+    for (const auto& [key, quantity] : inTransit) expected += std::abs(quantity) > 1e-9;
+    expect(rows == expected, "in transit has " + std::to_string(rows) + " rows, items need " + std::to_string(expected));
+  }
+
+  // Partial sends split a child off the item: item#delivery, then item#delivery.2
+  void split_children() const {
+    reset();
+    company("acme", { "a1", "a2" });
+    items("acme", "a1", { { "i0", 10 } });
+
+    send("d1", "acme", "a1", "acme", "a2", { { "i0", 3 } });
+    expect(quantity("i0") == 7, "parent keeps 7, has " + str(quantity("i0")));
+    expect(quantity("i0#d1") == 3, "child i0#d1 carries 3");
+    expect(item_field("i0#d1", [](const Item& i) { return i.delivery; }) == "d1", "child travels on d1");
+    expect(item_field("i0#d1", [](const Item& i) { return i.metadata.at("parent"); }) == "i0", "child records its parent");
+
+    edit_cargo("acme", "d1", { { "i0", 2 } });
+    expect(quantity("i0") == 5, "parent keeps 5, has " + str(quantity("i0")));
+    expect(quantity("i0#d1") == 3, "first child unchanged");
+    expect(quantity("i0#d1.2") == 2, "second child i0#d1.2 carries 2");
+
+    // An item already in transit is never split again
+    bool rejected = false;
+    try {
+      edit_cargo("acme", "d1", { { "i0#d1", 1 } });
+    } catch (const eosio::eosio_assert_failure&) {
+      rejected = true;
+    }
+    expect(rejected, "lowering an in-transit item is rejected");
+    expect_balances_consistent();
+  }
+
+  // Sending moves quantity from the site balance to in transit, receiving and cancelling move it out
+  void balances() const {
+    reset();
+    company("acme", { "a1", "a2" });
+    company("beta", { "b1" });
+    items("acme", "a1", { { "r0", 4 }, { "r1", 6 }, { "c0", 5 } });
+    items("acme", "a2", { { "p0", 0.1 }, { "p1", 0.2 } });
+
+    send("dr", "acme", "a1", "beta", "b1", { { "r0", 4 }, { "r1", 6 } });
+    send("dc", "acme", "a1", "beta", "b1", { { "c0", 5 } });
+    expect_balances_consistent();
+
+    receive(user, "beta", "dr");
+    expect(delivery_status("dr") == "delivered", "dr is " + delivery_status("dr"));
+    expect(item_field("r1", [](const Item& i) { return i.site; }) == "b1", "r1 arrived at b1");
+    expect_balances_consistent();
+
+    cancel("acme", "dc");
+    expect(delivery_status("dc") == "cancelled", "dc is " + delivery_status("dc"));
+    expect(item_field("c0", [](const Item& i) { return i.site; }) == "a1", "c0 is back at a1");
+    expect_balances_consistent();
+
+    // 0.1 + 0.2 - 0.1 - 0.2 is not 0 in doubles: the rows must still go
+    send("d1", "acme", "a2", "beta", "b1", { { "p0", 0.1 } });
+    send("d2", "acme", "a2", "beta", "b1", { { "p1", 0.2 } });
+    expect_balances_consistent();
+    {
+      auto c = contract();
+      for (const auto& row : c._balances) expect(row.site != "a2", "balance of a2 left at " + str(row.quantity));
+    }
+
+    receive(user, "beta", "d1");
+    receive(user, "beta", "d2");
+    expect_balances_consistent();
+    auto c = contract();
+    for (const auto& row : c._in_transit) throw check_failure("in-transit row " + row.company + " left at " + str(row.quantity));
+  }
+
+  // A job that cannot move a line fails there without holding up the others, and resumes from
+  // that line once cranked by index or started again
+  void jobs() const {
+    reset();
+    company("acme", { "a1", "a2" });
+    const std::size_t lines = tracelytics::JOB_INLINE_STEPS + 50;
+    std::vector<std::pair<std::string, double>> d0, d1;
+    for (std::size_t i = 0; i < lines; ++i) {
+      d0.emplace_back("x" + std::to_string(i), 5);
+      d1.emplace_back("y" + std::to_string(i), 5);
+    }
+    items("acme", "a1", d0);
+    items("acme", "a1", d1);
+    send("d0", "acme", "a1", "acme", "a2", d0);
+    send("d1", "acme", "a1", "acme", "a2", d1);
+
+    // Change a d0 item behind the job's back, so its line cannot move
+    auto set_quantity = [&](double quantity) {
+      act([&](auto& c) {
+        for (auto item = c._items.begin(); item != c._items.end(); ++item) {
+          if (item->itemId == "x7") c._items.modify(item, self, [&](auto& i) { i.quantity = quantity; });
+        }
+      });
+    };
+    set_quantity(4);
+
+    receive(user, "acme", "d0");
+    receive(user, "acme", "d1");
+    crank_all();
+    uint64_t failed;
+    {
+      auto c = contract();
+      failed = job(c, JobType::RECEIVE_DELIVERY).index;
+      expect(c._jobs.get(failed).status == JobStatus::FAILED, "d0's job failed");
+    }
+    expect(delivery_status("d0") == "receiving", "d0 is still receiving");
+    expect(delivery_status("d1") == "delivered", "d1 was received past the failed job");
+
+    // Cranked by index while the line still cannot move: fails again where it was
+    act([&](auto& c) { c.crank(1000, failed); });
+    {
+      auto c = contract();
+      expect(c._jobs.get(failed).status == JobStatus::FAILED, "d0's job fails again");
+    }
+
+    uint64_t steps;
+    {
+      auto c = contract();
+      steps = c._jobs.get(failed).steps;
+    }
+    set_quantity(5);
+    act([&](auto& c) { c.crank(1, failed); });
+    {
+      auto c = contract();
+      expect(c._jobs.get(failed).status != JobStatus::FAILED, "d0's job resumed by index");
+      expect(c._jobs.get(failed).steps > steps, "d0's job moved on from the failed line");
+    }
+    expect(item_field("x7", [](const Item& i) { return i.site; }) == "a2", "the failed line moved");
+
+    // Started again by a retried receive, it finishes
+    receive("admin", "acme", "d0");
+    crank_all();
+    {
+      auto c = contract();
+      expect(c._jobs.get(failed).status == JobStatus::DONE, "d0's job is done");
+      expect(c._jobs.get(failed).steps >= lines, "d0's job took every line");
+    }
+    expect(delivery_status("d0") == "delivered", "d0 is " + delivery_status("d0"));
+    expect(item_field("x7", [](const Item& i) { return i.site; }) == "a2", "x7 arrived");
+    expect_balances_consistent();
+
+    act([&](auto& c) { c.prunejobs(10); });
+    auto c = contract();
+    for (const auto& job : c._jobs) throw check_failure("job " + std::to_string(job.index) + " left after prunejobs");
+  }
+
+  // rolluplog works off a backlog from its cursor, once per row, including rows logged behind it
+  void rollups() const {
+    reset();
+    company("acme", { "a1" });
+    std::vector<std::pair<std::string, double>> logged;
+    for (int i = 0; i < 25; ++i) logged.emplace_back("l" + std::to_string(i), 1);
+    items("acme", "a1", logged);
+
+    auto rolled = [&] {
+      auto c = contract();
+      uint64_t count = 0;
+      for (const auto& rollup : c._log_rollups) count += rollup.count;
+      return count;
+    };
+    const time_point cutoff = at(86400 * 60);
+
+    act([&](auto& c) { c.rolluplog(cutoff, 10); });
+    expect(rolled() == 10, "first call rolled up 10 rows, got " + std::to_string(rolled()));
+    act([&](auto& c) { c.rolluplog(cutoff, 10); });
+    expect(rolled() == 20, "second call resumed at row 10, total " + std::to_string(rolled()));
+    act([&](auto& c) { c.rolluplog(cutoff, 10); });
+    expect(rolled() == 25, "third call finished the backlog, total " + std::to_string(rolled()));
+
+    // A row logged in a month the cursor has passed
+    act([&](auto& c) {
+      c.newitem(user, "acme", "a1", "late", product, 1, {}, Actions::NEW_ITEM, "late", at(-86400 * 40), data, std::nullopt);
+    });
+    act([&](auto& c) { c.rolluplog(cutoff, 10); });
+    expect(rolled() == 26, "backdated row rolled up, total " + std::to_string(rolled()));
+
+    auto c = contract();
+    for (const auto& partition : c._log_partitions) throw check_failure("partition " + std::to_string(partition.period) + " left");
+  }
+
+  // purgecompany leaves no row of the company in any stage and keeps the others' rows whole
+  void purge() const {
+    reset();
+    company("acme", { "a1", "a2" });
+    company("beta", { "b1" });
+    items("acme", "a1", { { "a-0", 5 }, { "a-1", 5 }, { "a-2", 5 }, { "a-3", 5 } });
+    items("beta", "b1", { { "b-0", 5 }, { "b-1", 5 } });
+    send("ab", "acme", "a1", "beta", "b1", { { "a-0", 5 } });
+    send("ba", "beta", "b1", "acme", "a1", { { "b-0", 5 } });
+    send("aa", "acme", "a1", "acme", "a2", { { "a-1", 5 } });
+    act([&](auto& c) {
+      auto inputs = cargo({ { "a-2", 2 } });
+      CargoLines outputs;
+      c.newprocess(user, "acme", "pr", "washing", "a1", at(1), inputs, outputs, at(1), data,
+                   std::nullopt, std::nullopt, std::nullopt, std::nullopt, std::nullopt);
+    });
+    act([&](auto& c) { c.rolluplog(at(1), 3); });
+
+    uint64_t acme;
+    {
+      auto c = contract();
+      acme = c.intern("acme");
+    }
+    // Small calls, so every stage is resumed from its cursor
+    act([&](auto& c) { c.purgecompany("acme", 3); });
+    for (int i = 0; i < 1000 && pending_jobs() > 0; ++i) {
+      act([&](auto& c) { c.crank(3, std::nullopt); });
+    }
+    expect(pending_jobs() == 0, "purge still pending");
+
+    auto c = contract();
+    auto of_acme = [](const std::string& company) {
+      return company == "acme" || company.rfind("acme -> ", 0) == 0 || (company.size() > 8 && company.compare(company.size() - 8, 8, " -> acme") == 0);
+    };
+    for (const auto& row : c._companies)  expect(row.companyId != "acme", "company row left");
+    for (const auto& row : c._sites)      expect(!of_acme(row.company), "site " + row.siteId + " left");
+    for (const auto& row : c._items)      expect(!of_acme(row.company), "item " + row.itemId + " left");
+    for (const auto& row : c._balances)   expect(!of_acme(row.company), "balance of " + row.site + " left");
+    for (const auto& row : c._in_transit) expect(!of_acme(row.company), "in transit " + row.company + " left");
+    for (const auto& row : c._processes)  expect(!of_acme(row.company), "process " + row.processId + " left");
+    for (const auto& row : c._log_rollups) expect(row.company != acme, "rollup left");
+
+    std::vector<uint64_t> deliveries;
+    for (const auto& row : c._deliveries) {
+      expect(row.fromCompany != "acme" && row.toCompany != "acme", "delivery " + row.deliveryId + " left");
+      deliveries.push_back(row.index);
+    }
+    for (const auto& row : c._delivery_lines) {
+      expect(std::find(deliveries.begin(), deliveries.end(), row.delivery) != deliveries.end(), "line of a purged delivery left");
+    }
+    for (const auto& partition : c._log_partitions) {
+      tracelytics::inventory_log_table logs(self, partition.period);
+      for (const auto& row : logs) expect(row.company != acme, "log row left");
+    }
+
+    expect(quantity("b-1") == 5, "beta's item kept");
+    expect_balances_consistent();
+  }
+
+  // cleartable item takes the balances with the items, and new items start them afresh
+  void clear_items() const {
+    reset();
+    company("acme", { "a1", "a2" });
+    std::vector<std::pair<std::string, double>> stock;
+    for (int i = 0; i < 20; ++i) stock.emplace_back("s" + std::to_string(i), 2.5);
+    items("acme", "a1", stock);
+    send("d", "acme", "a1", "acme", "a2", { { "s0", 2.5 }, { "s1", 2.5 } });
+
+    act([&](auto& c) { c.cleartable("item", 7); });
+    crank_all();
+    expect_balances_consistent();
+    {
+      auto c = contract();
+      for (const auto& row : c._items) throw check_failure("item " + row.itemId + " left");
+    }
+
+    items("acme", "a1", { { "n0", 3 } });
+    expect_balances_consistent();
+
+    bool rejected = false;
+    try {
+      act([&](auto& c) { c.cleartable("not a table", 1); });
+    } catch (const eosio::eosio_assert_failure& e) {
+      rejected = std::string(e.what()).find("unknown table") != std::string::npos;
+    }
+    expect(rejected, "unknown table names are rejected");
+  }
+};
+
+int main(int argc, char** argv) {
+  tracelytics_checks checks;
+  const std::vector<std::pair<const char*, void (tracelytics_checks::*)() const>> all = {
+    { "split_children", &tracelytics_checks::split_children },
+    { "balances",       &tracelytics_checks::balances },
+    { "jobs",           &tracelytics_checks::jobs },
+    { "rollups",        &tracelytics_checks::rollups },
+    { "purge",          &tracelytics_checks::purge },
+    { "clear_items",    &tracelytics_checks::clear_items },
+  };
+
+  int failures = 0;
+  for (const auto& [name, check] : all) {
+    bool selected = argc == 1;
+    for (int i = 1; i < argc; ++i) selected |= std::string(argv[i]) == name;
+    if (!selected) continue;
+
+    try {
+      (checks.*check)();
+      std::printf("ok    %s\n", name);
+    } catch (const std::exception& e) {
+      std::printf("FAIL  %s: %s\n", name, e.what());
+      ++failures;
+    }
+  }
+  return failures == 0 ? 0 : 1;
+}
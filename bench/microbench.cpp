@@ -0,0 +1,287 @@
+/**
+ * Host-side microbenchmarks for the per-line helpers
+ *
+ *  - tracelytics::processDelivery (deliveries.hpp)
+ *  - tracelytics::editdelivery    (2-line cargo edit of a delivery of any size)
+ *  - tracelytics::processcargo    (processes.hpp)
+ *  - tracelytics::upsertitem      (processes.hpp)
+ *
+ * Each benchmark seeds a fresh in-memory database, then times the helper
+ * itself ("direct") and the inline actions it queued ("inline") separately,
+ * for every cargo size requested.
+ *
+ * Usage: microbench [--sizes=1,10,100,1000,10000] [--repeat=3] [--csv]
+ **/
+#include "tracelytics/tracelytics.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct tracelytics_bench {
+  using Delivery = tracelytics::Delivery;
+  using Process  = tracelytics::Process;
+
+  struct Result {
+    double direct_us = 0;
+    double inline_us = 0;
+    native::stats counters;
+  };
+
+  const eosio::name self = "tracelytics"_n;
+  const std::string user    = "bench";
+  const std::string company = "acme";
+  const std::string product = "widget";
+  const std::string fromSite = "acme-a";
+  const std::string toSite   = "acme-b";
+  const double itemQuantity  = 10;
+
+  tracelytics contract() const {
+    return tracelytics(self, self, datastream<const char*>(nullptr, 0));
+  }
+
+  static time_point at(int64_t seconds) {
+    return time_point(eosio::seconds(1577836800 + seconds));
+  }
+
+  static std::string item_id(std::size_t i) {
+    return "item-" + std::to_string(i);
+  }
+
+  // Roughly what a transaction carrying `lines` cargo lines packs to
+  static void set_transaction_for(std::size_t lines) {
+    native::set_transaction(std::vector<char>(256 + lines * 64, 'x'));
+  }
+
+  void seed(std::size_t items) const {
+    native::reset();
+    std::map<std::string, std::string> data;
+    std::map<std::string, std::string> metadata;
+
+    auto c = contract();
+    c.newcompany(user, company, company, "Acme", at(0), data,
+                 std::nullopt, std::nullopt, std::nullopt, std::nullopt, std::nullopt, std::nullopt,
+                 std::nullopt, std::nullopt, std::nullopt, std::nullopt, std::nullopt);
+    c.newsite(user, company, fromSite, company, true, at(0), data,
+              std::nullopt, std::nullopt, std::nullopt, std::nullopt, std::nullopt);
+    c.newsite(user, company, toSite, company, true, at(0), data,
+              std::nullopt, std::nullopt, std::nullopt, std::nullopt, std::nullopt);
+    for (std::size_t i = 0; i < items; ++i) {
+      c.newitem(user, company, fromSite, item_id(i), product, itemQuantity, metadata,
+                Actions::NEW_ITEM, item_id(i), at(0), data, std::nullopt);
+    }
+    native::drain();
+  }
+
+  CargoLines cargo(std::size_t lines, double quantity) const {
+    CargoLines result;
+    for (std::size_t i = 0; i < lines; ++i) {
+      ProductQuantity pq;
+      pq.product  = product;
+      pq.quantity = quantity;
+      result.emplace_back(item_id(i), pq);
+    }
+    Cargo::normalize(result);
+    return result;
+  }
+
+  static Result measure(const std::function<void()>& fn) {
+    using clock = std::chrono::steady_clock;
+    Result result;
+
+    native::reset_counters();
+    auto start = clock::now();
+    fn();
+    auto direct = clock::now();
+    native::drain();
+    auto done = clock::now();
+
+    result.direct_us = std::chrono::duration<double, std::micro>(direct - start).count();
+    result.inline_us = std::chrono::duration<double, std::micro>(done - direct).count();
+    result.counters  = native::counters();
+    return result;
+  }
+
+  // SEND_DELIVERY of every seeded item from acme-a to acme-b
+  Result process_delivery(std::size_t lines) const {
+    seed(lines);
+    set_transaction_for(lines);
+
+    Delivery d;
+    d.index       = 0;
+    d.deliveryId  = "delivery-1";
+    d.fromCompany = company;
+    d.toCompany   = company;
+    d.fromSite    = fromSite;
+    d.toSite      = toSite;
+    d.createdBy   = user;
+    d.updatedBy   = user;
+    d.createdAt   = at(1);
+    d.updatedAt   = at(1);
+
+    auto sent = cargo(lines, itemQuantity);
+    return measure([&] {
+      auto c = contract();
+      c.processDelivery(d, sent, DeliveryActivity::SEND_DELIVERY, Actions::NEW_DELIVERY);
+      c.commit_items();
+    });
+  }
+
+  // Adds 2 items to a loading delivery that already carries `lines`
+  Result edit_delivery(std::size_t lines) const {
+    seed(lines + 2);
+    set_transaction_for(2);
+
+    std::map<std::string, std::string> data;
+    {
+      auto sent = cargo(lines, itemQuantity);
+      auto c = contract();
+      c.newdelivery(user, company, "delivery-1", "", fromSite, toSite, company, company, at(1), "Send Delivery", sent, at(1), data,
+                    std::nullopt, std::nullopt, std::nullopt, std::string("loading"), std::nullopt, std::nullopt);
+    }
+    native::drain();
+
+    CargoLines deltas;
+    for (std::size_t i = lines; i < lines + 2; ++i) {
+      ProductQuantity pq;
+      pq.product  = product;
+      pq.quantity = itemQuantity;
+      deltas.emplace_back(item_id(i), pq);
+    }
+    return measure([&] {
+      auto c = contract();
+      c.editdelivery(user, company, "delivery-1", "", deltas, at(2), data,
+                     std::nullopt, std::nullopt, std::nullopt, std::nullopt, std::nullopt, std::nullopt, std::nullopt, std::nullopt, std::nullopt);
+    });
+  }
+
+  // START_PROCESS consuming every seeded item at acme-a
+  Result process_cargo(std::size_t lines) const {
+    seed(lines);
+    set_transaction_for(lines);
+
+    Process p;
+    p.index     = 0;
+    p.company   = company;
+    p.processId = "process-1";
+    p.type      = ProcessType::PROCESS;
+    p.site      = fromSite;
+    p.createdBy = user;
+    p.updatedBy = user;
+    p.createdAt = at(1);
+    p.updatedAt = at(1);
+    p.inputs    = cargo(lines, itemQuantity);
+
+    CargoLines emptyDeltas;
+    return measure([&] {
+      auto c = contract();
+      c.processcargo(p, p.inputs, emptyDeltas, user, company, Actions::NEW_PROCESS, ProcessActivity::START_PROCESS);
+    });
+  }
+
+  // One upsertitem per line: debit existing items (edit) or create new ones
+  Result upsert_item(std::size_t lines, bool create) const {
+    seed(create ? 0 : lines);
+    set_transaction_for(lines);
+
+    std::map<std::string, std::string> metadata;
+    return measure([&] {
+      auto c = contract();
+      for (std::size_t i = 0; i < lines; ++i) {
+        c.upsertitem(user, company, fromSite, item_id(i), product, create ? itemQuantity : -1.0,
+                     metadata, Actions::NEW_PROCESS, "process-1", at(1));
+      }
+    });
+  }
+};
+
+namespace {
+  struct Options {
+    std::vector<std::size_t> sizes = { 1, 10, 100, 1000, 10000 };
+    int repeat = 3;
+    bool csv = false;
+  };
+
+  Options parse(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+      std::string arg = argv[i];
+      if (arg.rfind("--sizes=", 0) == 0) {
+        options.sizes.clear();
+        std::string list = arg.substr(8);
+        std::size_t pos = 0;
+        while (pos < list.size()) {
+          auto comma = list.find(',', pos);
+          if (comma == std::string::npos) comma = list.size();
+          options.sizes.push_back(std::stoull(list.substr(pos, comma - pos)));
+          pos = comma + 1;
+        }
+      } else if (arg.rfind("--repeat=", 0) == 0) {
+        options.repeat = std::max(1, std::stoi(arg.substr(9)));
+      } else if (arg == "--csv") {
+        options.csv = true;
+      } else {
+        std::fprintf(stderr, "usage: %s [--sizes=1,10,100] [--repeat=3] [--csv]\n", argv[0]);
+        std::exit(1);
+      }
+    }
+    return options;
+  }
+
+  void report(const Options& options, const char* benchmark, std::size_t lines, const tracelytics_bench::Result& r) {
+    double total = r.direct_us + r.inline_us;
+    const auto& c = r.counters;
+    if (options.csv) {
+      std::printf("%s,%zu,%.1f,%.1f,%.1f,%.3f,%llu,%llu,%llu,%llu\n",
+                  benchmark, lines, total, r.direct_us, r.inline_us, total / lines,
+                  (unsigned long long) c.inline_actions, (unsigned long long) c.sha256_calls,
+                  (unsigned long long) c.sha256_bytes, (unsigned long long) c.secondary_writes);
+    } else {
+      std::printf("%-22s %7zu %12.1f %12.1f %12.1f %10.3f %8llu %9llu %11llu %9llu\n",
+                  benchmark, lines, total, r.direct_us, r.inline_us, total / lines,
+                  (unsigned long long) c.inline_actions, (unsigned long long) c.sha256_calls,
+                  (unsigned long long) c.sha256_bytes, (unsigned long long) c.secondary_writes);
+    }
+  }
+
+  // Best of `repeat` runs
+  tracelytics_bench::Result best(int repeat, const std::function<tracelytics_bench::Result()>& run) {
+    auto result = run();
+    for (int i = 1; i < repeat; ++i) {
+      auto next = run();
+      if (next.direct_us + next.inline_us < result.direct_us + result.inline_us) result = next;
+    }
+    return result;
+  }
+}
+
+int main(int argc, char** argv) {
+  auto options = parse(argc, argv);
+  tracelytics_bench bench;
+
+  if (options.csv) {
+    std::printf("benchmark,lines,total_us,direct_us,inline_us,us_per_line,inline_actions,sha256_calls,sha256_bytes,secondary_writes\n");
+  } else {
+    std::printf("%-22s %7s %12s %12s %12s %10s %8s %9s %11s %9s\n",
+                "benchmark", "lines", "total_us", "direct_us", "inline_us", "us/line",
+                "inlines", "sha256", "sha_bytes", "idx_wr");
+  }
+
+  try {
+    for (auto lines : options.sizes) {
+      if (lines == 0) continue;
+      report(options, "processDelivery", lines, best(options.repeat, [&] { return bench.process_delivery(lines); }));
+      report(options, "editdelivery",    lines, best(options.repeat, [&] { return bench.edit_delivery(lines); }));
+      report(options, "processcargo",    lines, best(options.repeat, [&] { return bench.process_cargo(lines); }));
+      report(options, "upsertitem/edit", lines, best(options.repeat, [&] { return bench.upsert_item(lines, false); }));
+      report(options, "upsertitem/new",  lines, best(options.repeat, [&] { return bench.upsert_item(lines, true); }));
+    }
+  } catch (const eosio::eosio_assert_failure& e) {
+    std::fprintf(stderr, "assertion failure: %s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <eosio/host.hpp>
+#include <eosio/name.hpp>
+#include <eosio/datastream.hpp>
+
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace eosio {
+
+struct permission_level {
+  name actor;
+  name permission;
+};
+
+inline void require_auth(name) { ++native::counters().require_auths; }
+inline bool has_auth(name)     { return true; }
+
+namespace detail {
+  template <typename T> struct member_class;
+  template <typename C, typename R, typename... Args>
+  struct member_class<R (C::*)(Args...)> { using type = C; };
+}
+
+/**
+ * Native stand-in for eosio::action_wrapper. send() copies the arguments and
+ * queues the action; it runs on a fresh contract instance once the current
+ * action has finished, like an inline action on chain.
+ **/
+template <name::raw Name, auto Action>
+struct action_wrapper {
+  using contract_type = typename detail::member_class<decltype(Action)>::type;
+
+  action_wrapper(name code, const permission_level& perm) : code_name(code), permissions({perm}) {}
+  action_wrapper(name code, std::vector<permission_level> perms) : code_name(code), permissions(std::move(perms)) {}
+
+  template <typename... Args>
+  void send(Args&&... args) const {
+    native::schedule([code = code_name, tup = std::make_tuple(std::decay_t<Args>(std::forward<Args>(args))...)]() mutable {
+      contract_type c(code, code, datastream<const char*>(nullptr, 0));
+      std::apply([&](auto&... a) { (c.*Action)(a...); }, tup);
+    });
+  }
+
+  name code_name;
+  std::vector<permission_level> permissions;
+};
+
+} // namespace eosio
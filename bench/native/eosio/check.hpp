@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+
+namespace eosio {
+
+/**
+ * Thrown by check() in native builds, where the chain would abort the transaction
+ **/
+struct eosio_assert_failure : std::runtime_error {
+  using std::runtime_error::runtime_error;
+};
+
+inline void check(bool pred, const char* msg) {
+  if (!pred) throw eosio_assert_failure(msg);
+}
+inline void check(bool pred, const std::string& msg) {
+  if (!pred) throw eosio_assert_failure(msg);
+}
+
+} // namespace eosio
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+namespace eosio {
+
+/**
+ * Native stand-in for eosio::fixed_bytes<32>
+ **/
+class checksum256 {
+  public:
+    checksum256() { _data.fill(0); }
+    explicit checksum256(const std::array<uint8_t, 32>& bytes) : _data(bytes) {}
+
+    std::array<uint8_t, 32> extract_as_byte_array() const { return _data; }
+    const uint8_t* data() const { return _data.data(); }
+    std::size_t size() const { return _data.size(); }
+
+    friend bool operator==(const checksum256& a, const checksum256& b) { return a._data == b._data; }
+    friend bool operator!=(const checksum256& a, const checksum256& b) { return a._data != b._data; }
+    friend bool operator< (const checksum256& a, const checksum256& b) { return a._data <  b._data; }
+
+  private:
+    std::array<uint8_t, 32> _data;
+};
+
+struct public_key {
+  std::array<char, 34> data{};
+};
+
+struct signature {
+  std::array<char, 66> data{};
+};
+
+checksum256 sha256(const char* data, uint32_t length);
+
+inline void assert_recover_key(const checksum256&, const signature&, const public_key&) {}
+
+} // namespace eosio
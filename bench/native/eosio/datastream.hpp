@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+
+namespace eosio {
+
+template <typename T>
+class datastream {
+  public:
+    datastream(T start, std::size_t s) : _start(start), _pos(start), _end(start + s) {}
+
+    T pos() const { return _pos; }
+    std::size_t remaining() const { return _end - _pos; }
+
+  private:
+    T _start;
+    T _pos;
+    T _end;
+};
+
+} // namespace eosio
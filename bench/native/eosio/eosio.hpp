@@ -0,0 +1,33 @@
+#pragma once
+
+/**
+ * Native (host-compiled) stand-in for the eosio.cdt headers, used by the
+ * benchmarks under bench/. Only the subset of the CDT API the contract uses
+ * is provided; attributes the ABI generator reads are dropped.
+ **/
+
+#include <eosio/action.hpp>
+#include <eosio/check.hpp>
+#include <eosio/contract.hpp>
+#include <eosio/crypto.hpp>
+#include <eosio/datastream.hpp>
+#include <eosio/host.hpp>
+#include <eosio/multi_index.hpp>
+#include <eosio/name.hpp>
+#include <eosio/print.hpp>
+#include <eosio/time.hpp>
+
+#include <algorithm>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+typedef unsigned __int128 uint128_t;
+typedef __int128          int128_t;
+
+#define CONTRACT class
+#define ACTION   void
+#define TABLE    struct
+
+#define EOSLIB_SERIALIZE(TYPE, MEMBERS)
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <eosio/name.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+/**
+ * Host state for native builds: the chain database, the inline action
+ * queue, the current transaction and a few counters the benchmarks report.
+ **/
+namespace eosio::native {
+
+struct stats {
+  uint64_t sha256_calls      = 0;
+  uint64_t sha256_bytes      = 0;
+  uint64_t rows_emplaced     = 0;
+  uint64_t rows_modified     = 0;
+  uint64_t rows_erased       = 0;
+  uint64_t secondary_writes  = 0;
+  uint64_t inline_actions    = 0;
+  uint64_t require_auths     = 0;
+};
+
+stats& counters();
+void reset_counters();
+
+// Database
+struct table_base {
+  virtual ~table_base() = default;
+};
+using table_id = std::tuple<uint64_t, uint64_t, uint64_t>; // code, scope, table
+
+std::map<table_id, std::unique_ptr<table_base>>& tables();
+
+template <typename Storage>
+Storage& table(uint64_t code, uint64_t scope, uint64_t table_name) {
+  auto& slot = tables()[table_id{code, scope, table_name}];
+  if (!slot) slot = std::make_unique<Storage>();
+  return static_cast<Storage&>(*slot);
+}
+
+// Inline actions are queued while an action runs and executed afterwards, depth first
+void schedule(std::function<void()> action);
+void execute(const std::function<void()>& action);
+std::size_t pending();
+void drain();
+
+// Transaction being applied (read_transaction / transaction_size)
+void set_transaction(std::vector<char> packed);
+const std::vector<char>& transaction();
+
+// Block time (current_time_point), in microseconds since epoch
+void set_time(int64_t us);
+int64_t time();
+
+// Drops all tables, queued actions and counters
+void reset();
+
+} // namespace eosio::native
@@ -0,0 +1,367 @@
+#pragma once
+
+#include <eosio/check.hpp>
+#include <eosio/host.hpp>
+#include <eosio/name.hpp>
+
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <set>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace eosio {
+
+inline constexpr name same_payer{};
+
+template <class Class, typename Type, Type (Class::*PtrToMemberFunction)() const>
+struct const_mem_fun {
+  typedef typename std::remove_reference<Type>::type result_type;
+
+  Type operator()(const Class& x) const { return (x.*PtrToMemberFunction)(); }
+};
+
+template <name::raw IndexName, typename Extractor>
+struct indexed_by {
+  static constexpr uint64_t index_name = static_cast<uint64_t>(IndexName);
+  typedef Extractor secondary_extractor_type;
+};
+
+/**
+ * In-memory stand-in for eosio::multi_index.
+ *
+ * Rows live in the host database (shared by every table object with the same
+ * code/scope/name, so inline actions see earlier writes). Secondary keys are
+ * kept as ordered (key, primary key) sets and, as on chain, every extractor
+ * runs once on emplace and twice on modify.
+ **/
+template <name::raw TableName, typename T, typename... Indices>
+class multi_index {
+  private:
+    template <typename Index>
+    using secondary_key_of = std::decay_t<typename Index::secondary_extractor_type::result_type>;
+
+    template <std::size_t I>
+    using index_type_at = std::tuple_element_t<I, std::tuple<Indices...>>;
+
+    struct storage : native::table_base {
+      std::map<uint64_t, std::unique_ptr<T>> rows;
+      std::tuple<std::set<std::pair<secondary_key_of<Indices>, uint64_t>>...> secondaries;
+      std::array<uint64_t, sizeof...(Indices)> generations{};
+    };
+
+    template <typename Key>
+    static bool keys_equal(const Key& a, const Key& b) { return !(a < b) && !(b < a); }
+
+    static constexpr std::size_t index_position(uint64_t index_name) {
+      constexpr std::array<uint64_t, sizeof...(Indices)> names{ {Indices::index_name...} };
+      for (std::size_t i = 0; i < names.size(); ++i) {
+        if (names[i] == index_name) return i;
+      }
+      return names.size();
+    }
+
+    template <typename F, std::size_t... Is>
+    static void for_each_index(F&& f, std::index_sequence<Is...>) {
+      (f(std::integral_constant<std::size_t, Is>{}), ...);
+    }
+    template <typename F>
+    static void for_each_index(F&& f) {
+      for_each_index(std::forward<F>(f), std::index_sequence_for<Indices...>{});
+    }
+
+    static auto secondary_keys(const T& obj) {
+      return std::make_tuple(typename Indices::secondary_extractor_type()(obj)...);
+    }
+
+  public:
+    class const_iterator {
+      public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type        = const T;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const T*;
+        using reference         = const T&;
+
+        const_iterator() = default;
+
+        const T& operator*()  const { return _it == _end ? end_row() : *_it->second; }
+        const T* operator->() const { return &**this; }
+
+        const_iterator& operator++() { ++_it; return *this; }
+        const_iterator& operator--() { --_it; return *this; }
+        const_iterator operator++(int) { auto copy = *this; ++_it; return copy; }
+        const_iterator operator--(int) { auto copy = *this; --_it; return copy; }
+
+        friend bool operator==(const const_iterator& a, const const_iterator& b) { return a._it == b._it; }
+        friend bool operator!=(const const_iterator& a, const const_iterator& b) { return a._it != b._it; }
+
+      private:
+        friend multi_index;
+        using base_iterator = typename std::map<uint64_t, std::unique_ptr<T>>::const_iterator;
+        const_iterator(base_iterator it, base_iterator end) : _it(it), _end(end) {}
+        base_iterator _it;
+        base_iterator _end;
+    };
+
+    template <std::size_t I>
+    class index {
+      public:
+        using secondary_key_type = secondary_key_of<index_type_at<I>>;
+        using extractor_type     = typename index_type_at<I>::secondary_extractor_type;
+
+      private:
+        using entry    = std::pair<secondary_key_type, uint64_t>;
+        using set_type = std::set<entry>;
+
+      public:
+        /**
+         * Survives writes to the index: if the entry it points to moved (its
+         * key was modified) or was erased, it re-finds its position on use.
+         **/
+        class const_iterator {
+          public:
+            using iterator_category = std::bidirectional_iterator_tag;
+            using value_type        = const T;
+            using difference_type   = std::ptrdiff_t;
+            using pointer           = const T*;
+            using reference         = const T&;
+
+            const_iterator() = default;
+
+            const T& operator*()  const {
+              auto it = sync();
+              return it == _midx->template secondary_set<I>().end() ? _midx->end_row() : _midx->row(it->second);
+            }
+            const T* operator->() const { return &**this; }
+
+            const_iterator& operator++() { capture(std::next(sync())); return *this; }
+            const_iterator& operator--() { capture(std::prev(sync())); return *this; }
+            const_iterator operator++(int) { auto copy = *this; ++*this; return copy; }
+            const_iterator operator--(int) { auto copy = *this; --*this; return copy; }
+
+            friend bool operator==(const const_iterator& a, const const_iterator& b) { return a.sync() == b.sync(); }
+            friend bool operator!=(const const_iterator& a, const const_iterator& b) { return !(a == b); }
+
+            uint64_t primary_key() const { return sync()->second; }
+
+          private:
+            friend index;
+            const_iterator(const multi_index* midx, typename set_type::const_iterator it) : _midx(midx) { capture(it); }
+
+            void capture(typename set_type::const_iterator it) const {
+              _it     = it;
+              _gen    = _midx->template generation<I>();
+              _at_end = it == _midx->template secondary_set<I>().end();
+              if (!_at_end) _val = *it;
+            }
+
+            typename set_type::const_iterator sync() const {
+              if (_gen == _midx->template generation<I>()) return _it;
+
+              const auto& s = _midx->template secondary_set<I>();
+              if (_at_end) {
+                capture(s.end());
+                return _it;
+              }
+              auto it = s.find(_val);
+              if (it == s.end() && _midx->_db->rows.count(_val.second)) {
+                it = s.find(entry{ extractor_type()(_midx->row(_val.second)), _val.second });
+              }
+              if (it == s.end()) {
+                it = s.lower_bound(_val);
+              }
+              capture(it);
+              return _it;
+            }
+
+            const multi_index* _midx = nullptr;
+            mutable typename set_type::const_iterator _it;
+            mutable uint64_t _gen = 0;
+            mutable bool _at_end = true;
+            mutable entry _val{};
+        };
+
+        explicit index(multi_index* midx) : _midx(midx) {}
+
+        name get_code() const     { return _midx->get_code(); }
+        uint64_t get_scope() const { return _midx->get_scope(); }
+
+        const_iterator cbegin() const { return { _midx, set().begin() }; }
+        const_iterator begin()  const { return cbegin(); }
+        const_iterator cend()   const { return { _midx, set().end() }; }
+        const_iterator end()    const { return cend(); }
+
+        const_iterator lower_bound(const secondary_key_type& key) const {
+          return { _midx, set().lower_bound(entry{ key, 0 }) };
+        }
+        const_iterator upper_bound(const secondary_key_type& key) const {
+          return { _midx, set().upper_bound(entry{ key, std::numeric_limits<uint64_t>::max() }) };
+        }
+        const_iterator find(const secondary_key_type& key) const {
+          auto it = set().lower_bound(entry{ key, 0 });
+          if (it == set().end() || !keys_equal(it->first, key)) return cend();
+          return { _midx, it };
+        }
+        const T& get(const secondary_key_type& key, const char* error_msg = "unable to find secondary key") const {
+          auto result = find(key);
+          check(result != cend(), error_msg);
+          return *result;
+        }
+        const_iterator iterator_to(const T& obj) const {
+          return { _midx, set().find(entry{ extractor_type()(obj), obj.primary_key() }) };
+        }
+
+        template <typename Lambda>
+        void modify(const_iterator itr, name payer, Lambda&& updater) {
+          check(itr != cend(), "cannot pass end iterator to modify");
+          _midx->modify(*itr, payer, std::forward<Lambda>(updater));
+        }
+
+        const_iterator erase(const_iterator itr) {
+          check(itr != cend(), "cannot pass end iterator to erase");
+          auto pk   = itr.primary_key();
+          auto next = std::next(set().find(*itr.sync()));
+          entry after = next == set().end() ? entry{} : *next;
+          bool last = next == set().end();
+          _midx->erase(_midx->row(pk));
+          return last ? cend() : const_iterator{ _midx, set().find(after) };
+        }
+
+      private:
+        const set_type& set() const { return _midx->template secondary_set<I>(); }
+        multi_index* _midx;
+    };
+
+    multi_index(name code, uint64_t scope)
+      : _code(code), _scope(scope),
+        _db(&native::table<storage>(code.value, scope, static_cast<uint64_t>(TableName))) {}
+
+    name get_code() const      { return _code; }
+    uint64_t get_scope() const { return _scope; }
+
+    const_iterator cbegin() const { return const_iterator(_db->rows.cbegin(), _db->rows.cend()); }
+    const_iterator begin()  const { return cbegin(); }
+    const_iterator cend()   const { return const_iterator(_db->rows.cend(), _db->rows.cend()); }
+    const_iterator end()    const { return cend(); }
+
+    const_iterator find(uint64_t primary) const          { return const_iterator(_db->rows.find(primary), _db->rows.cend()); }
+    const_iterator lower_bound(uint64_t primary) const   { return const_iterator(_db->rows.lower_bound(primary), _db->rows.cend()); }
+    const_iterator upper_bound(uint64_t primary) const   { return const_iterator(_db->rows.upper_bound(primary), _db->rows.cend()); }
+    const_iterator iterator_to(const T& obj) const       { return find(obj.primary_key()); }
+    const_iterator require_find(uint64_t primary, const char* error_msg = "unable to find key") const {
+      auto itr = find(primary);
+      check(itr != cend(), error_msg);
+      return itr;
+    }
+    const T& get(uint64_t primary, const char* error_msg = "unable to find key") const {
+      return *require_find(primary, error_msg);
+    }
+
+    uint64_t available_primary_key() const {
+      return _db->rows.empty() ? 0 : _db->rows.rbegin()->first + 1;
+    }
+
+    template <name::raw IndexName>
+    auto get_index() {
+      constexpr std::size_t position = index_position(static_cast<uint64_t>(IndexName));
+      static_assert(position < sizeof...(Indices), "name provided is not the name of any secondary index within multi_index");
+      return index<position>(this);
+    }
+    template <name::raw IndexName>
+    auto get_index() const {
+      return const_cast<multi_index*>(this)->template get_index<IndexName>();
+    }
+
+    template <typename Lambda>
+    const_iterator emplace(name payer, Lambda&& constructor) {
+      auto obj = std::make_unique<T>();
+      constructor(*obj);
+
+      auto pk = obj->primary_key();
+      check(_db->rows.count(pk) == 0, "could not insert object, most likely a uniqueness constraint was violated");
+
+      auto keys = secondary_keys(*obj);
+      for_each_index([&](auto i) {
+        constexpr std::size_t I = decltype(i)::value;
+        secondary_set<I>().emplace(std::get<I>(keys), pk);
+        ++_db->generations[I];
+        ++native::counters().secondary_writes;
+      });
+      ++native::counters().rows_emplaced;
+
+      return const_iterator(_db->rows.emplace(pk, std::move(obj)).first, _db->rows.cend());
+    }
+
+    template <typename Lambda>
+    void modify(const_iterator itr, name payer, Lambda&& updater) {
+      check(itr != cend(), "cannot pass end iterator to modify");
+      modify(*itr, payer, std::forward<Lambda>(updater));
+    }
+
+    template <typename Lambda>
+    void modify(const T& obj, name payer, Lambda&& updater) {
+      auto& mutableobj = const_cast<T&>(obj);
+      auto pk     = obj.primary_key();
+      auto before = secondary_keys(obj);
+
+      updater(mutableobj);
+      check(pk == obj.primary_key(), "updater cannot change primary key when modifying an object");
+
+      auto after = secondary_keys(obj);
+      for_each_index([&](auto i) {
+        constexpr std::size_t I = decltype(i)::value;
+        if (keys_equal(std::get<I>(before), std::get<I>(after))) return;
+        secondary_set<I>().erase({ std::get<I>(before), pk });
+        secondary_set<I>().emplace(std::get<I>(after), pk);
+        ++_db->generations[I];
+        ++native::counters().secondary_writes;
+      });
+      ++native::counters().rows_modified;
+    }
+
+    const_iterator erase(const_iterator itr) {
+      check(itr != cend(), "cannot pass end iterator to erase");
+      auto next = std::next(itr);
+      erase(*itr);
+      return next;
+    }
+
+    void erase(const T& obj) {
+      auto pk   = obj.primary_key();
+      auto keys = secondary_keys(obj);
+      for_each_index([&](auto i) {
+        constexpr std::size_t I = decltype(i)::value;
+        secondary_set<I>().erase({ std::get<I>(keys), pk });
+        ++_db->generations[I];
+      });
+      _db->rows.erase(pk);
+      ++native::counters().rows_erased;
+    }
+
+  private:
+    const T& row(uint64_t pk) const { return *_db->rows.at(pk); }
+
+    // Dereferencing end() reads a zeroed row, as it does in wasm linear memory
+    static const T& end_row() {
+      static const T empty = T();
+      return empty;
+    }
+
+    template <std::size_t I>
+    auto& secondary_set() const { return std::get<I>(_db->secondaries); }
+
+    template <std::size_t I>
+    uint64_t generation() const { return _db->generations[I]; }
+
+    name     _code;
+    uint64_t _scope;
+    storage* _db;
+};
+
+} // namespace eosio
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <eosio/name.hpp>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace eosio {
+
+template <typename... Args>
+inline void print(Args&&... args) {
+  if (std::getenv("TRACELYTICS_NATIVE_PRINT") == nullptr) return;
+  ((std::cout << args), ...);
+}
+
+} // namespace eosio
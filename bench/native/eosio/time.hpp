@@ -0,0 +1,63 @@
+#pragma once
+
+#include <eosio/host.hpp>
+
+#include <cstdint>
+
+namespace eosio {
+
+class microseconds {
+  public:
+    constexpr explicit microseconds(int64_t c = 0) : _count(c) {}
+    constexpr int64_t count() const { return _count; }
+
+    friend constexpr bool operator==(const microseconds& a, const microseconds& b) { return a._count == b._count; }
+    friend constexpr bool operator!=(const microseconds& a, const microseconds& b) { return a._count != b._count; }
+    friend constexpr bool operator< (const microseconds& a, const microseconds& b) { return a._count <  b._count; }
+    friend constexpr bool operator<=(const microseconds& a, const microseconds& b) { return a._count <= b._count; }
+    friend constexpr bool operator> (const microseconds& a, const microseconds& b) { return a._count >  b._count; }
+    friend constexpr bool operator>=(const microseconds& a, const microseconds& b) { return a._count >= b._count; }
+    constexpr microseconds operator+(const microseconds& m) const { return microseconds(_count + m._count); }
+    constexpr microseconds operator-(const microseconds& m) const { return microseconds(_count - m._count); }
+
+  private:
+    int64_t _count;
+};
+
+inline constexpr microseconds seconds(int64_t s) { return microseconds(s * 1000000); }
+inline constexpr microseconds days(int64_t d)    { return seconds(d * 24 * 60 * 60); }
+
+class time_point {
+  public:
+    constexpr explicit time_point(microseconds e = microseconds()) : elapsed(e) {}
+
+    constexpr const microseconds& time_since_epoch() const { return elapsed; }
+    constexpr uint32_t sec_since_epoch() const { return uint32_t(elapsed.count() / 1000000); }
+
+    friend constexpr bool operator==(const time_point& a, const time_point& b) { return a.elapsed == b.elapsed; }
+    friend constexpr bool operator!=(const time_point& a, const time_point& b) { return a.elapsed != b.elapsed; }
+    friend constexpr bool operator< (const time_point& a, const time_point& b) { return a.elapsed <  b.elapsed; }
+    friend constexpr bool operator<=(const time_point& a, const time_point& b) { return a.elapsed <= b.elapsed; }
+    friend constexpr bool operator> (const time_point& a, const time_point& b) { return a.elapsed >  b.elapsed; }
+    friend constexpr bool operator>=(const time_point& a, const time_point& b) { return a.elapsed >= b.elapsed; }
+    constexpr time_point operator+(const microseconds& m) const { return time_point(elapsed + m); }
+    constexpr time_point operator-(const microseconds& m) const { return time_point(elapsed - m); }
+
+    microseconds elapsed;
+};
+
+class time_point_sec {
+  public:
+    constexpr explicit time_point_sec(uint32_t s = 0) : utc_seconds(s) {}
+    time_point_sec(const time_point& t) : utc_seconds(t.sec_since_epoch()) {}
+
+    constexpr uint32_t sec_since_epoch() const { return utc_seconds; }
+
+    uint32_t utc_seconds;
+};
+
+inline time_point current_time_point() {
+  return time_point(microseconds(native::time()));
+}
+
+} // namespace eosio
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <eosio/host.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace eosio {
+
+inline std::size_t transaction_size() {
+  return native::transaction().size();
+}
+
+inline std::size_t read_transaction(char* buffer, std::size_t size) {
+  const auto& tx = native::transaction();
+  auto copied = std::min(size, tx.size());
+  if (copied > 0) std::memcpy(buffer, tx.data(), copied);
+  return copied;
+}
+
+} // namespace eosio
@@ -3,18 +3,31 @@
 CONTRACT tracelytics : public contract {
   using contract::contract;
 
+#ifdef TRACELYTICS_NATIVE
+  // Native benchmarks and checks (bench/) call the private processing helpers directly
+  friend struct tracelytics_bench;
+  friend struct tracelytics_checks;
+#endif
+
   public:
     tracelytics( name receiver, name code, datastream<const char*> ds )
       : contract(receiver, code, ds),
+        _balances(receiver, receiver.value),
         _companies(receiver, receiver.value),
         _deliveries(receiver, receiver.value),
-        _inventory_logs(receiver, receiver.value),
+        _delivery_lines(receiver, receiver.value),
+        _in_transit(receiver, receiver.value),
+        _log_partitions(receiver, receiver.value),
+        _log_rollups(receiver, receiver.value),
+        _rollup_cursor(receiver, receiver.value),
         _items(receiver, receiver.value),
+        _jobs(receiver, receiver.value),
         _machines(receiver, receiver.value),
         _processes(receiver, receiver.value),
         _products(receiver, receiver.value),
         _recipes(receiver, receiver.value),
         _sites(receiver, receiver.value),
+        _symbols(receiver, receiver.value),
         _users(receiver, receiver.value) {}
 
     // Create
@@ -45,7 +58,7 @@ CONTRACT tracelytics : public contract {
                           const std::string& toCompany,
                           const time_point& startTime,
                           const std::string& type,
-                          std::map<std::string, ProductQuantity>& cargo,
+                          CargoLines& cargo,
                           const time_point& timestamp,
                           const std::map<std::string, std::string>& data,
                           const optional<time_point>& endTime,
@@ -81,8 +94,8 @@ CONTRACT tracelytics : public contract {
                           const std::string& type,
                           const std::string& site,
                           const time_point& startTime,
-                          const std::map<std::string, ProductQuantity>& inputs,
-                          const std::map<std::string, ProductQuantity>& outputs,
+                          const CargoLines& inputs,
+                          const CargoLines& outputs,
                           const time_point& timestamp,
                           const std::map<std::string, std::string>& data,
                           const optional<time_point>& endTime,
@@ -161,7 +174,7 @@ CONTRACT tracelytics : public contract {
                           const std::string& company,
                           const std::string& deliveryId,
                           const std::string& route,
-                          std::map<std::string, ProductQuantity>& cargoDeltas,
+                          CargoLines& cargoDeltas,
                           const time_point& timestamp,
                           const std::map<std::string, std::string>& data,
 
@@ -200,8 +213,8 @@ CONTRACT tracelytics : public contract {
     ACTION editprocess  ( const std::string& user,
                           const std::string& company,
                           const std::string& processId,
-                          const std::map<std::string, ProductQuantity>& inputDeltas,
-                          const std::map<std::string, ProductQuantity>& outputDeltas,
+                          CargoLines& inputDeltas,
+                          CargoLines& outputDeltas,
                           const time_point& timestamp,
                           const std::map<std::string, std::string>& data,
                           const optional<time_point>& startTime,
@@ -303,16 +316,41 @@ CONTRACT tracelytics : public contract {
                           const std::string& userId,
                           const time_point&  timestamp);
 
-    ACTION cleartable (const std::string& tableName);
-    ACTION clearall ();
+    // Clearing runs as a job: each call erases up to max_rows rows, resuming the pending job of the
+    // same kind if there is one, and crank can finish it. purgecompany erases one tenant's rows.
+    ACTION cleartable (const std::string& tableName, const uint32_t& max_rows);
+    ACTION clearall (const uint32_t& max_rows);
+    ACTION purgecompany (const std::string& company, const uint32_t& max_rows);
+
+    // Drops the oldest log rows of a period (YYYYMM), up to max_rows per call.
+    // The partition leaves the directory once it is empty, with its transactions and key counters.
+    ACTION droplogs (const uint64_t& period, const uint32_t& max_rows);
+
+    // Folds log rows older than cutoff into daily (company, site, product) rollups and erases them,
+    // examining at most max_rows rows per call. Repeated calls resume where the last one stopped.
+    ACTION rolluplog (const time_point& cutoff, const uint32_t& max_rows);
+
+    // Works off pending jobs, oldest first, for at most max_steps steps (cargo lines). Anyone may call it.
+    // Given a job index, works on that job only, retrying it if it failed.
+    ACTION crank (const uint32_t& max_steps, const optional<uint64_t>& job);
+
+    // Erases up to max_rows finished (done) jobs, oldest first
+    ACTION prunejobs (const uint32_t& max_rows);
+
+    // Erases up to max_rows rows, returns how many (fewer than max_rows once the table is empty)
+    template <typename T>
+    uint32_t cleanTable(uint32_t max_rows){
+      return cleanTable<T>(get_self().value, max_rows);
+    }
 
     template <typename T>
-    void cleanTable(){
-      T db(get_self(), get_self().value);
-      auto itr = db.end();
-      while(db.begin() != itr){
-        itr = db.erase(--itr);
+    uint32_t cleanTable(uint64_t scope, uint32_t max_rows){
+      T db(get_self(), scope);
+      uint32_t rows = 0;
+      for (auto itr = db.begin(); itr != db.end() && rows < max_rows; ++rows) {
+        itr = db.erase(itr);
       }
+      return rows;
     }
 
     ACTION push(
@@ -326,32 +364,21 @@ CONTRACT tracelytics : public contract {
       std::map<std::string, std::string> data
     );
 
-    // Logging
-    ACTION loginventory ( const std::string& user,
-                          const std::string& company,
-                          const std::string& item,
-                          const std::string& site,
-                          const std::string& product,
-                          const std::string& delivery,
-                          std::map<std::string, std::string> metadata,
-                          const std::string& action,
-                          const std::string& parentAction,
-                          const std::string& parentActionId,
-                          const time_point&  timestamp,
-                          const std::string& version,
-                          const double&     oldQuantity,
-                          const double&     newQuantity);
+#ifdef TRACELYTICS_LOG_NOTIFY
+    // One notification per action listing the inventory logs it wrote, for indexers following traces
+    ACTION logbatch ( const std::vector<InventoryLogNotice>& logs );
+#endif
+
+    // Saves what the action buffered (primary key counters, log notifications)
+    ~tracelytics();
 
     // Action wrappers
-    using loginventory_action = action_wrapper<name("loginventory"), &tracelytics::loginventory>;
-    using newitem_action      = action_wrapper<name("newitem"),      &tracelytics::newitem>;
-    using edititem_action     = action_wrapper<name("edititem"),     &tracelytics::edititem>;
     using delitem_action      = action_wrapper<name("delitem"),      &tracelytics::delitem>;
     using editprocess_action  = action_wrapper<name("editprocess"),  &tracelytics::editprocess>;
     using editdelivery_action = action_wrapper<name("editdelivery"), &tracelytics::editdelivery>;
-
-    // General function
-    static checksum256 SHA256(const std::string& stringToSha);
+#ifdef TRACELYTICS_LOG_NOTIFY
+    using logbatch_action     = action_wrapper<name("logbatch"),     &tracelytics::logbatch>;
+#endif
 
   private:
     TABLE Company {
@@ -366,7 +393,7 @@ CONTRACT tracelytics : public contract {
       std::string fax;
       time_point customerSince;
       int64_t currentClient = 0;
-      std::string status = DeliveryStatus::LOADING;
+      std::string status = "loading";
       std::string description;
       std::string version = "0.0.1";
       std::string createdBy;
@@ -376,7 +403,7 @@ CONTRACT tracelytics : public contract {
       std::map<std::string, std::string> data;
 
       uint64_t primary_key() const { return index;             };
-      checksum256 by_id()    const { return SHA256(companyId); };
+      IndexKey    by_id()    const { return Key::cached<&Company::by_id>(index, companyId); };
     };
 
     TABLE Delivery {
@@ -391,67 +418,106 @@ CONTRACT tracelytics : public contract {
       time_point endTime;
       std::string shipper;
       std::string driver;
-      std::string status;
-      std::string type;
+      uint8_t status = DeliveryStatus::NONE;
+      std::string customStatus; // Status string while status is OTHER
+      uint8_t type   = DeliveryType::NONE;
       std::string description;
       std::string version = "0.0.1";
       std::string createdBy;
       std::string updatedBy;
       time_point createdAt;
       time_point updatedAt;
-      std::map<std::string, ProductQuantity> cargo;
-      std::map<std::string, std::string> data;
+      std::map<std::string, std::string> data; // Cargo is in the deliveryline table
 
       uint64_t primary_key() const { return index; };
       std::string id() const { return deliveryId; };
 
-      checksum256 by_id()                       const { return SHA256(deliveryId                                    ); };
-      checksum256 by_route()                    const { return SHA256(deliveryId  + ";" + route                     ); };
-      checksum256 by_from_company_site_status() const { return SHA256(fromCompany + ";" + fromSite + ";" + status   ); }; // Raptor Site A -> * && (Status)
-      checksum256 by_to_company_site_status()   const { return SHA256(toCompany   + ";" + toSite   + ";" + status   ); }; // * -> Raptor Site A && (Status)
-      checksum256 by_from_to_site()             const { return SHA256(fromCompany + ";" + fromSite + ";" + toSite   ); }; // Raptor -> Supply Site A
-      checksum256 by_to_from_site()             const { return SHA256(toCompany   + ";" + toSite   + ";" + fromSite ); }; // Supply Site A -> Raptor
-      checksum256 by_from_to_company()          const { return SHA256(fromCompany + ";" + toCompany                 ); }; // Raptor <-> Supplier || Raptor <-> Raptor
-
-      checksum256 by_from_site()                const { return SHA256(fromCompany + ";" + fromSite                  ); }; // Raptor Site A -> *
-      checksum256 by_to_site()                  const { return SHA256(toCompany   + ";" + toSite                    ); }; // * -> Raptor Site A
-      checksum256 by_from_company()             const { return SHA256(fromCompany                                   ); }; // Raptor -> *
-      checksum256 by_to_company()               const { return SHA256(toCompany                                     ); }; // * -> Raptor
-      uint128_t   by_from_site_latest()         const { return ((uint128_t) truncate_sha256_to_uint64(SHA256(fromCompany + ";" + fromSite + ";" + status)) << 64) | updatedAt.elapsed.count(); };
-      uint128_t   by_to_site_latest()           const { return ((uint128_t) truncate_sha256_to_uint64(SHA256(toCompany   + ";" + toSite + ";" + status))   << 64) | updatedAt.elapsed.count(); };
+      std::string_view status_name() const { return status == DeliveryStatus::OTHER ? std::string_view(customStatus) : DeliveryStatus::name(status); };
+      void set_status(uint8_t code)          { status = code; customStatus.clear(); };
+      void set_status(std::string_view name) { status = DeliveryStatus::parse(name); customStatus = status == DeliveryStatus::OTHER ? name : std::string_view(); };
+
+      IndexKey    by_id()                       const { return Key::cached<&Delivery::by_id>(index, deliveryId);                                                                };
+      IndexKey    by_route()                    const { return Key::cached<&Delivery::by_route>(index, deliveryId, route);                                                      };
+      IndexKey    by_from_company_site_status() const { return Key::cached<&Delivery::by_from_company_site_status>(index, fromCompany, fromSite, status_name());                }; // Raptor Site A -> * && (Status)
+      IndexKey    by_to_company_site_status()   const { return Key::cached<&Delivery::by_to_company_site_status>(index, toCompany, toSite, status_name());                      }; // * -> Raptor Site A && (Status)
+      IndexKey    by_from_to_site()             const { return Key::cached<&Delivery::by_from_to_site>(index, fromCompany, fromSite, toSite);                                   }; // Raptor -> Supply Site A
+      IndexKey    by_to_from_site()             const { return Key::cached<&Delivery::by_to_from_site>(index, toCompany, toSite, fromSite);                                     }; // Supply Site A -> Raptor
+      IndexKey    by_from_to_company()          const { return Key::cached<&Delivery::by_from_to_company>(index, fromCompany, toCompany);                                       }; // Raptor <-> Supplier || Raptor <-> Raptor
+
+      IndexKey    by_from_site()                const { return Key::cached<&Delivery::by_from_site>(index, fromCompany, fromSite); }; // Raptor Site A -> *
+      IndexKey    by_to_site()                  const { return Key::cached<&Delivery::by_to_site>(index, toCompany, toSite);       }; // * -> Raptor Site A
+      IndexKey    by_from_company()             const { return Key::cached<&Delivery::by_from_company>(index, fromCompany);        }; // Raptor -> *
+      IndexKey    by_to_company()               const { return Key::cached<&Delivery::by_to_company>(index, toCompany);            }; // * -> Raptor
+      uint128_t   by_from_site_latest()         const { return ((uint128_t) Key::cached64<&Delivery::by_from_site_latest>(index, fromCompany, fromSite, status_name()) << 64) | updatedAt.elapsed.count(); };
+      uint128_t   by_to_site_latest()           const { return ((uint128_t) Key::cached64<&Delivery::by_to_site_latest>(index, toCompany, toSite, status_name()) << 64) | updatedAt.elapsed.count(); };
     };
 
-    TABLE InventoryLog {
-      uint64_t index;
-      std::string user;
-      std::string company;
-      std::string item;
-      std::string site;
+    // One cargo line of a delivery, so cargo edits rewrite only the lines they touch
+    TABLE DeliveryLine {
+      uint64_t    index;
+      uint64_t    delivery; // Delivery::index
+      std::string itemId;
       std::string product;
-      std::string delivery;
+      double      quantity;
       std::map<std::string, std::string> metadata;
-      std::string action;
-      std::string parentAction;
-      std::string parentActionId;
+
+      uint64_t  primary_key()           const { return index; };
+      uint128_t by_delivery_and_item()  const { return ((uint128_t) delivery << 64) | Key::cached64<&DeliveryLine::by_delivery_and_item>(index, itemId); }; // All lines of a delivery share the upper half
+    };
+
+    // ID fields are handles into the symbol table (see intern). Only what cannot be derived is
+    // stored: the old quantity is newQuantity - delta, and metadata is read from the item.
+    TABLE InventoryLog {
+      uint64_t index;
+      uint64_t user;
+      uint64_t company;
+      uint64_t item;
+      uint64_t site;
+      uint64_t product;
+      uint64_t delivery;
+      uint64_t action;
+      uint64_t parentAction;
+      uint64_t parentActionId;
       time_point timestamp;
-      double oldQuantity;
       double newQuantity;
       double delta;
-      checksum256 txid;
-      std::string version = "0.0.1";
-      std::map<std::string, std::string> data;
+      uint64_t transaction; // Row in the transaction table of the same partition
+
+      uint64_t primary_key()                  const { return index;                                    };
+      double      old_quantity()              const { return newQuantity - delta;                      };
+      IndexKey    by_item()                   const { return Key::pack(company, item);                 };
+      IndexKey    by_company()                const { return Key::pack(company);                       };
+      IndexKey    by_site()                   const { return Key::pack(company, site);                 };
+      IndexKey    by_product()                const { return Key::pack(company, product);              };
+      IndexKey    by_delivery()               const { return delivery ? Key::present(Key::pack(delivery)) : Key::absent(index); }; // Sparse
+      IndexKey    by_user()                   const { return Key::pack(company, user);                 };
+      IndexKey    by_site_and_product()       const { return Key::pack(company, site, product);        };
+      IndexKey    by_parent_action_id()       const { return Key::pack(company, parentActionId);       };
+      IndexKey    by_user_and_parent_action() const { return Key::pack(company, user, parentAction);   };
+    };
+    // Quantity of a product at a site, summed over the items there (kept up to date with Item::quantity)
+    TABLE Balance {
+      uint64_t    index;
+      std::string company;
+      std::string site;
+      std::string product;
+      double      quantity;
 
-      uint64_t primary_key()                  const { return index;                                             };
-      checksum256 by_item()                   const { return SHA256(company + ";" + item);                      };
-      checksum256 by_company()                const { return SHA256(company);                                   };
-      checksum256 by_site()                   const { return SHA256(company + ";" + site);                      };
-      checksum256 by_product()                const { return SHA256(company + ";" + product);                   };
-      checksum256 by_delivery()               const { return SHA256(delivery);                                  };
-      checksum256 by_user()                   const { return SHA256(company + ";" + user);                      };
-      checksum256 by_site_and_product()       const { return SHA256(company + ";" + site + ";" + product);      };
-      checksum256 by_parent_action_id()       const { return SHA256(company + ";" + parentActionId);            };
-      checksum256 by_user_and_parent_action() const { return SHA256(company + ";" + user + ";" + parentAction); };
+      uint64_t primary_key()         const { return index; };
+      IndexKey by_site_and_product() const { return Key::cached<&Balance::by_site_and_product>(index, company, site, product); }; // Same key as Item::by_site_and_product
     };
+
+    // Quantity of a product in transit between two companies (company is "from -> to", as on the items)
+    TABLE InTransit {
+      uint64_t    index;
+      std::string company;
+      std::string product;
+      double      quantity;
+
+      uint64_t primary_key() const { return index; };
+      IndexKey by_product()  const { return Key::cached<&InTransit::by_product>(index, company, product); }; // Same key as Item::by_product
+    };
+
     TABLE Item {
       uint64_t    index;
       std::string company;
@@ -470,13 +536,13 @@ CONTRACT tracelytics : public contract {
 
       uint64_t primary_key() const { return index; };
 
-      checksum256 by_id()               const { return SHA256(itemId);                               }; // Specific item (UNIQUE)
-      checksum256 by_company()          const { return SHA256(company);                              }; // All items across a company
-      checksum256 by_site()             const { return SHA256(company + ";" + site);                 }; // All items at a specific site
-      checksum256 by_product()          const { return SHA256(company + ";" + product);              }; // All items matching product at company
-      checksum256 by_delivery()         const { return SHA256(delivery);                             }; // By the creator of the item
-      checksum256 by_site_and_product() const { return SHA256(company + ";" + site + ";" + product); }; // All items matching product at site
-      checksum256 by_creator()          const { return SHA256(company + ";" + createdBy);            }; // By the creator of the item
+      IndexKey    by_id()               const { return Key::cached<&Item::by_id>(index, itemId);                               }; // Specific item (UNIQUE)
+      IndexKey    by_company()          const { return Key::cached<&Item::by_company>(index, company);                         }; // All items across a company
+      IndexKey    by_site()             const { return Key::cached<&Item::by_site>(index, company, site);                      }; // All items at a specific site
+      IndexKey    by_product()          const { return Key::cached<&Item::by_product>(index, company, product);                }; // All items matching product at company
+      IndexKey    by_delivery()         const { return Key::sparse<&Item::by_delivery>(index, delivery.empty(), delivery);     }; // Items in transit (sparse)
+      IndexKey    by_site_and_product() const { return Key::cached<&Item::by_site_and_product>(index, company, site, product); }; // All items matching product at site
+      IndexKey    by_creator()          const { return Key::cached<&Item::by_creator>(index, company, createdBy);              }; // By the creator of the item
     };
 
     TABLE Machine {
@@ -495,43 +561,51 @@ CONTRACT tracelytics : public contract {
       std::map<std::string, std::string> data;
 
       uint64_t    primary_key()       const { return index;                             };
-      checksum256 by_company_and_id() const { return SHA256(company + ";" + machineId); };
-      checksum256 by_company()        const { return SHA256(company);                   };
-      checksum256 by_site()           const { return SHA256(company + ";" + site);      };
+      IndexKey    by_company_and_id() const { return Key::cached<&Machine::by_company_and_id>(index, company, machineId); };
+      IndexKey    by_company()        const { return Key::cached<&Machine::by_company>(index, company);                   };
+      IndexKey    by_site()           const { return Key::cached<&Machine::by_site>(index, company, site);                };
     };
 
     TABLE Process {
       uint64_t index;
       std::string company;
       std::string processId;
-      std::string type;
+      uint8_t type = ProcessType::NONE;
+      std::string customType; // Type string while type is OTHER
       std::string machine;
       std::string site;
       time_point startTime;
       time_point endTime;
-      std::string status;
+      uint8_t status = ProcessStatus::NONE;
+      std::string customStatus; // Status string while status is OTHER
       std::string description;
       std::string createdBy;
       std::string updatedBy;
       time_point createdAt;
       time_point updatedAt;
       std::string version = "0.0.1";
-      std::map<std::string, ProductQuantity> inputs;
-      std::map<std::string, ProductQuantity> outputs;
+      CargoLines inputs;
+      CargoLines outputs;
       std::map<std::string, std::string> data;
 
       uint64_t    primary_key()       const { return index;                             };
       std::string id()                const { return processId;                         };
 
-      checksum256 by_company_and_id() const { return SHA256(company + ";" + processId          );   };
-      checksum256 by_company()        const { return SHA256(company                            );   };
-      checksum256 by_type()           const { return SHA256(company + ";" + type               );   };
-      checksum256 by_creator()        const { return SHA256(company + ";" + createdBy          );   };
-      checksum256 by_updater()        const { return SHA256(company + ";" + updatedBy          );   };
-      checksum256 by_site()           const { return SHA256(company + ";" + site               );   };
-      checksum256 by_site_status()    const { return SHA256(company + ";" + site + ";" + status);   };
-      checksum256 by_site_type()      const { return SHA256(company + ";" + site + ";" + type  );   };
-      checksum256 by_machine()        const { return SHA256(company + ";" + machine            );   };
+      std::string_view status_name() const { return status == ProcessStatus::OTHER ? std::string_view(customStatus) : ProcessStatus::name(status); };
+      void set_status(uint8_t code)          { status = code; customStatus.clear(); };
+      void set_status(std::string_view name) { status = ProcessStatus::parse(name); customStatus = status == ProcessStatus::OTHER ? name : std::string_view(); };
+      std::string_view type_name() const     { return type == ProcessType::OTHER ? std::string_view(customType) : ProcessType::name(type); };
+      void set_type(std::string_view name)   { type = ProcessType::parse(name); customType = type == ProcessType::OTHER ? name : std::string_view(); };
+
+      IndexKey    by_company_and_id() const { return Key::cached<&Process::by_company_and_id>(index, company, processId);                      };
+      IndexKey    by_company()        const { return Key::cached<&Process::by_company>(index, company);                                        };
+      IndexKey    by_type()           const { return Key::cached<&Process::by_type>(index, company, type_name());                              };
+      IndexKey    by_creator()        const { return Key::cached<&Process::by_creator>(index, company, createdBy);                             };
+      IndexKey    by_updater()        const { return Key::cached<&Process::by_updater>(index, company, updatedBy);                             };
+      IndexKey    by_site()           const { return Key::cached<&Process::by_site>(index, company, site);                                     };
+      IndexKey    by_site_status()    const { return Key::cached<&Process::by_site_status>(index, company, site, status_name());               };
+      IndexKey    by_site_type()      const { return Key::cached<&Process::by_site_type>(index, company, site, type_name());                   };
+      IndexKey    by_machine()        const { return Key::sparse<&Process::by_machine>(index, machine.empty(), company, machine); }; // Sparse
     };
 
     TABLE Product {
@@ -551,7 +625,7 @@ CONTRACT tracelytics : public contract {
       std::map<std::string, std::string> data;
 
       uint64_t    primary_key() const { return index;      };
-      checksum256 by_id()       const { return SHA256(productId); };
+      IndexKey    by_id()       const { return Key::cached<&Product::by_id>(index, productId); };
     };
     TABLE Recipe {
       uint64_t index;
@@ -569,8 +643,8 @@ CONTRACT tracelytics : public contract {
       std::map<std::string, std::string> data;
 
       uint64_t    primary_key()       const { return index;                            };
-      checksum256 by_company_and_id() const { return SHA256(company + ";" + recipeId); };
-      checksum256 by_company()        const { return SHA256(company);                  };
+      IndexKey    by_company_and_id() const { return Key::cached<&Recipe::by_company_and_id>(index, company, recipeId); };
+      IndexKey    by_company()        const { return Key::cached<&Recipe::by_company>(index, company);                  };
     };
     TABLE Site {
       uint64_t index;
@@ -589,8 +663,8 @@ CONTRACT tracelytics : public contract {
       std::map<std::string, std::string> data;
 
       uint64_t    primary_key() const { return index;           };
-      checksum256 by_id()       const { return SHA256(siteId);  };
-      checksum256 by_company()  const { return SHA256(company); };
+      IndexKey    by_id()       const { return Key::cached<&Site::by_id>(index, siteId);       };
+      IndexKey    by_company()  const { return Key::cached<&Site::by_company>(index, company); };
     };
     TABLE User {
       uint64_t index;
@@ -613,11 +687,11 @@ CONTRACT tracelytics : public contract {
       std::map<std::string, std::string> data;
 
       uint64_t   primary_key()             const { return index;                                              };
-      checksum256 by_id()                  const { return SHA256(userId);                                     };
-      checksum256 by_company()             const { return SHA256(company);                                    };
-      checksum256 by_company_and_user_id() const { return SHA256(company + ";" + userId);                     };
-      checksum256 by_fullname()            const { return SHA256(company + ";" + firstName + ";" + lastName); };
-      checksum256 by_email()               const { return SHA256(company + ";" + email);                      };
+      IndexKey    by_id()                  const { return Key::cached<&User::by_id>(index, userId);                             };
+      IndexKey    by_company()             const { return Key::cached<&User::by_company>(index, company);                       };
+      IndexKey    by_company_and_user_id() const { return Key::cached<&User::by_company_and_user_id>(index, company, userId);   };
+      IndexKey    by_fullname()            const { return Key::sparse<&User::by_fullname>(index, firstName.empty() && lastName.empty(), company, firstName, lastName); }; // Sparse
+      IndexKey    by_email()               const { return Key::sparse<&User::by_email>(index, email.empty(), company, email); }; // Sparse
 
       // ----------------------------------------
       // EDIT THIS WHEN YOU ADD A FIELD TO USER
@@ -628,97 +702,314 @@ CONTRACT tracelytics : public contract {
                               (updatedAt)(version)(data) )
     };
 
+    TABLE Symbol {
+      uint64_t index;
+      std::string value;
+
+      uint64_t    primary_key() const { return index;            };
+      IndexKey    by_value()    const { return Key::hash(value); };
+    };
+
+    // Directory of inventory log partitions. Log rows are scoped by period (YYYYMM of their timestamp).
+    TABLE LogPartition {
+      uint64_t period;
+      time_point createdAt;
+
+      uint64_t primary_key() const { return period; };
+    };
+
+    // Daily totals of the log rows folded away by rolluplog. ID fields are symbol handles.
+    TABLE LogRollup {
+      uint64_t index;
+      time_point day; // Start of the UTC day
+      uint64_t company;
+      uint64_t site;
+      uint64_t product;
+      double totalDelta;
+      uint64_t count;
+      double minQuantity; // Of the quantities after each change
+      double maxQuantity;
+
+      uint64_t primary_key()  const { return index; };
+      IndexKey by_day_group() const { return Key::pack(day.sec_since_epoch() / 86400, company, site, product); };
+    };
+
+    // Where rolluplog stopped: next log row to examine for the cutoff it was last called with.
+    // Rows logged behind it (backdated, or into a recreated partition) move it back.
+    TABLE RollupCursor {
+      uint64_t id = 0;
+      time_point cutoff;
+      uint64_t period;
+      uint64_t next;
+
+      uint64_t primary_key() const { return id; };
+    };
+
+    // Work too large for one transaction (receiving, cancelling, deleting cargo). The action that starts a job
+    // does the first JOB_INLINE_STEPS steps, crank does the rest. Rows stay once DONE (or FAILED),
+    // for clients to see the outcome, until prunejobs.
+    TABLE Job {
+      uint64_t   index;
+      uint8_t    type   = JobType::NONE;
+      uint8_t    status = JobStatus::NONE;
+      uint8_t    stage  = 0; // Clearing and purge jobs: position in clear_stages
+      uint64_t   target; // Delivery::index (also once deleted), Process::index, table name (cleartable) or company symbol (purgecompany)
+      uint64_t   scope;  // Log partition being purged
+      uint64_t   cursor; // Where the next step starts: key half of a deliveryline, Key::hash64 of a process input, primary key
+      uint64_t   steps;  // Done so far
+      time_point createdAt;
+      time_point updatedAt;
+
+      uint64_t  primary_key() const { return index; };
+      uint128_t by_status()   const { return ((uint128_t) status << 64) | index; }; // Pending jobs in order
+      uint128_t by_target()   const { return ((uint128_t) type << 64) | target;  }; // Job of a delivery, process, table or company
+    };
+
+    // Next primary key of a table, scoped like the table itself (see next_index)
+    TABLE Counter {
+      uint64_t table; // Table name
+      uint64_t next;
+
+      uint64_t primary_key() const { return table; };
+    };
+
+    // Transactions that wrote log rows, scoped like the rows (by partition) so they go with it
+    TABLE Transaction {
+      uint64_t index;
+      checksum256 txid;
+      time_point createdAt;
+
+      uint64_t    primary_key() const { return index; };
+      checksum256 by_txid()     const { return txid;  };
+    };
+
+    // Index profiles (TRACELYTICS_INDEX_PROFILE): "analytics" builds every index, "minimal"
+    // only the ones the contract reads. Index numbers follow declaration order, so switching
+    // profiles requires clearing the delivery, inventorylog, item and process tables.
     typedef multi_index<eosio::name("company"), Company,
-      indexed_by<name("byid"), const_mem_fun<Company, checksum256, &Company::by_id>>
+      indexed_by<name("byid"), const_mem_fun<Company, IndexKey, &Company::by_id>>
     > company_table;
+#if defined(TRACELYTICS_INDEXES_MINIMAL)
+    typedef multi_index<eosio::name("delivery"), Delivery,
+      indexed_by<name("byroute"),      const_mem_fun<Delivery, IndexKey,    &Delivery::by_route>>
+    > delivery_table;
+#else
     typedef multi_index<eosio::name("delivery"), Delivery,
-      indexed_by<name("byid"),         const_mem_fun<Delivery, checksum256, &Delivery::by_id>>,
-      indexed_by<name("byroute"),      const_mem_fun<Delivery, checksum256, &Delivery::by_route>>,
-      indexed_by<name("fromcompstat"), const_mem_fun<Delivery, checksum256, &Delivery::by_from_company_site_status>>,
-      indexed_by<name("tocompstat"),   const_mem_fun<Delivery, checksum256, &Delivery::by_to_company_site_status>>,
-      indexed_by<name("fromtosite"),   const_mem_fun<Delivery, checksum256, &Delivery::by_from_to_site>>,
-      indexed_by<name("tofromsite"),   const_mem_fun<Delivery, checksum256, &Delivery::by_to_from_site>>,
-      indexed_by<name("fromtocomp"),   const_mem_fun<Delivery, checksum256, &Delivery::by_from_to_company>>,
-      indexed_by<name("byfromsite"),   const_mem_fun<Delivery, checksum256, &Delivery::by_from_site>>,
-      indexed_by<name("bytosite"),     const_mem_fun<Delivery, checksum256, &Delivery::by_to_site>>,
-      indexed_by<name("byfromcomp"),   const_mem_fun<Delivery, checksum256, &Delivery::by_from_company>>,
-      indexed_by<name("bytocomp"),     const_mem_fun<Delivery, checksum256, &Delivery::by_to_company>>,
+      indexed_by<name("byid"),         const_mem_fun<Delivery, IndexKey,    &Delivery::by_id>>,
+      indexed_by<name("byroute"),      const_mem_fun<Delivery, IndexKey,    &Delivery::by_route>>,
+      indexed_by<name("fromcompstat"), const_mem_fun<Delivery, IndexKey,    &Delivery::by_from_company_site_status>>,
+      indexed_by<name("tocompstat"),   const_mem_fun<Delivery, IndexKey,    &Delivery::by_to_company_site_status>>,
+      indexed_by<name("fromtosite"),   const_mem_fun<Delivery, IndexKey,    &Delivery::by_from_to_site>>,
+      indexed_by<name("tofromsite"),   const_mem_fun<Delivery, IndexKey,    &Delivery::by_to_from_site>>,
+      indexed_by<name("fromtocomp"),   const_mem_fun<Delivery, IndexKey,    &Delivery::by_from_to_company>>,
+      indexed_by<name("byfromsite"),   const_mem_fun<Delivery, IndexKey,    &Delivery::by_from_site>>,
+      indexed_by<name("bytosite"),     const_mem_fun<Delivery, IndexKey,    &Delivery::by_to_site>>,
+      indexed_by<name("byfromcomp"),   const_mem_fun<Delivery, IndexKey,    &Delivery::by_from_company>>,
+      indexed_by<name("bytocomp"),     const_mem_fun<Delivery, IndexKey,    &Delivery::by_to_company>>,
       indexed_by<name("newfromsite"),  const_mem_fun<Delivery, uint128_t,   &Delivery::by_from_site_latest>>,
       indexed_by<name("newtosite"),    const_mem_fun<Delivery, uint128_t,   &Delivery::by_to_site_latest>>
     > delivery_table;
+#endif
+    typedef multi_index<eosio::name("deliveryline"), DeliveryLine,
+      indexed_by<name("bydelivitem"),  const_mem_fun<DeliveryLine, uint128_t, &DeliveryLine::by_delivery_and_item>>
+    > delivery_line_table;
+#if defined(TRACELYTICS_INDEXES_MINIMAL)
+    typedef multi_index<eosio::name("inventorylog"), InventoryLog> inventory_log_table;
+#else
     typedef multi_index<eosio::name("inventorylog"), InventoryLog,
-      indexed_by<name("byitem"),       const_mem_fun<InventoryLog, checksum256, &InventoryLog::by_item>>,
-      indexed_by<name("bycompany"),    const_mem_fun<InventoryLog, checksum256, &InventoryLog::by_company>>,
-      indexed_by<name("bysite"),       const_mem_fun<InventoryLog, checksum256, &InventoryLog::by_site>>,
-      indexed_by<name("byproduct"),    const_mem_fun<InventoryLog, checksum256, &InventoryLog::by_product>>,
-      indexed_by<name("bydelivery"),   const_mem_fun<InventoryLog, checksum256, &InventoryLog::by_delivery>>,
-      indexed_by<name("byuser"),       const_mem_fun<InventoryLog, checksum256, &InventoryLog::by_user>>,
-      indexed_by<name("bysiteprod"),   const_mem_fun<InventoryLog, checksum256, &InventoryLog::by_site_and_product>>,
-      indexed_by<name("byparentid"),   const_mem_fun<InventoryLog, checksum256, &InventoryLog::by_parent_action_id>>,
-      indexed_by<name("byuserparent"), const_mem_fun<InventoryLog, checksum256, &InventoryLog::by_user_and_parent_action>>
+      indexed_by<name("byitem"),       const_mem_fun<InventoryLog, IndexKey,    &InventoryLog::by_item>>,
+      indexed_by<name("bycompany"),    const_mem_fun<InventoryLog, IndexKey,    &InventoryLog::by_company>>,
+      indexed_by<name("bysite"),       const_mem_fun<InventoryLog, IndexKey,    &InventoryLog::by_site>>,
+      indexed_by<name("byproduct"),    const_mem_fun<InventoryLog, IndexKey,    &InventoryLog::by_product>>,
+      indexed_by<name("bydelivery"),   const_mem_fun<InventoryLog, IndexKey,    &InventoryLog::by_delivery>>,
+      indexed_by<name("byuser"),       const_mem_fun<InventoryLog, IndexKey,    &InventoryLog::by_user>>,
+      indexed_by<name("bysiteprod"),   const_mem_fun<InventoryLog, IndexKey,    &InventoryLog::by_site_and_product>>,
+      indexed_by<name("byparentid"),   const_mem_fun<InventoryLog, IndexKey,    &InventoryLog::by_parent_action_id>>,
+      indexed_by<name("byuserparent"), const_mem_fun<InventoryLog, IndexKey,    &InventoryLog::by_user_and_parent_action>>
     > inventory_log_table;
+#endif
+#if defined(TRACELYTICS_INDEXES_MINIMAL)
     typedef multi_index<eosio::name("item"), Item,
-      indexed_by<name("byid"),        const_mem_fun<Item, checksum256, &Item::by_id>>,
-      indexed_by<name("bycompany"),   const_mem_fun<Item, checksum256, &Item::by_company>>,
-      indexed_by<name("bysite"),      const_mem_fun<Item, checksum256, &Item::by_site>>,
-      indexed_by<name("byproduct"),   const_mem_fun<Item, checksum256, &Item::by_product>>,
-      indexed_by<name("bydelivery"),  const_mem_fun<Item, checksum256, &Item::by_delivery>>,
-      indexed_by<name("bysiteprod"),  const_mem_fun<Item, checksum256, &Item::by_site_and_product>>,
-      indexed_by<name("bycreator"),   const_mem_fun<Item, checksum256, &Item::by_creator>>
+      indexed_by<name("byid"),        const_mem_fun<Item, IndexKey,    &Item::by_id>>
     > item_table;
+#else
+    typedef multi_index<eosio::name("item"), Item,
+      indexed_by<name("byid"),        const_mem_fun<Item, IndexKey,    &Item::by_id>>,
+      indexed_by<name("bycompany"),   const_mem_fun<Item, IndexKey,    &Item::by_company>>,
+      indexed_by<name("bysite"),      const_mem_fun<Item, IndexKey,    &Item::by_site>>,
+      indexed_by<name("byproduct"),   const_mem_fun<Item, IndexKey,    &Item::by_product>>,
+      indexed_by<name("bydelivery"),  const_mem_fun<Item, IndexKey,    &Item::by_delivery>>,
+      indexed_by<name("bysiteprod"),  const_mem_fun<Item, IndexKey,    &Item::by_site_and_product>>,
+      indexed_by<name("bycreator"),   const_mem_fun<Item, IndexKey,    &Item::by_creator>>
+    > item_table;
+#endif
     typedef multi_index<eosio::name("machine"), Machine,
-      indexed_by<name("bycompandid"), const_mem_fun<Machine, checksum256, &Machine::by_company_and_id>>,
-      indexed_by<name("bycompany"),   const_mem_fun<Machine, checksum256, &Machine::by_company>>,
-      indexed_by<name("bysite"),      const_mem_fun<Machine, checksum256, &Machine::by_site>>
+      indexed_by<name("bycompandid"), const_mem_fun<Machine, IndexKey,    &Machine::by_company_and_id>>,
+      indexed_by<name("bycompany"),   const_mem_fun<Machine, IndexKey,    &Machine::by_company>>,
+      indexed_by<name("bysite"),      const_mem_fun<Machine, IndexKey,    &Machine::by_site>>
     > machine_table;
+#if defined(TRACELYTICS_INDEXES_MINIMAL)
+    typedef multi_index<eosio::name("process"), Process,
+      indexed_by<name("bycompandid"),  const_mem_fun<Process, IndexKey,    &Process::by_company_and_id>>
+    > process_table;
+#else
     typedef multi_index<eosio::name("process"), Process,
-      indexed_by<name("bycompandid"),  const_mem_fun<Process, checksum256, &Process::by_company_and_id>>,
-      indexed_by<name("bycompany"),    const_mem_fun<Process, checksum256, &Process::by_company>>,
-      indexed_by<name("bytype"),       const_mem_fun<Process, checksum256, &Process::by_type>>,
-      indexed_by<name("bycreator"),    const_mem_fun<Process, checksum256, &Process::by_creator>>,
-      indexed_by<name("byupdater"),    const_mem_fun<Process, checksum256, &Process::by_updater>>,
-      indexed_by<name("bysite"),       const_mem_fun<Process, checksum256, &Process::by_site>>,
-      indexed_by<name("bysitestatus"), const_mem_fun<Process, checksum256, &Process::by_site_status>>,
-      indexed_by<name("bysitetype"),   const_mem_fun<Process, checksum256, &Process::by_site_type>>,
-      indexed_by<name("bymachine"),    const_mem_fun<Process, checksum256, &Process::by_machine>>
+      indexed_by<name("bycompandid"),  const_mem_fun<Process, IndexKey,    &Process::by_company_and_id>>,
+      indexed_by<name("bycompany"),    const_mem_fun<Process, IndexKey,    &Process::by_company>>,
+      indexed_by<name("bytype"),       const_mem_fun<Process, IndexKey,    &Process::by_type>>,
+      indexed_by<name("bycreator"),    const_mem_fun<Process, IndexKey,    &Process::by_creator>>,
+      indexed_by<name("byupdater"),    const_mem_fun<Process, IndexKey,    &Process::by_updater>>,
+      indexed_by<name("bysite"),       const_mem_fun<Process, IndexKey,    &Process::by_site>>,
+      indexed_by<name("bysitestatus"), const_mem_fun<Process, IndexKey,    &Process::by_site_status>>,
+      indexed_by<name("bysitetype"),   const_mem_fun<Process, IndexKey,    &Process::by_site_type>>,
+      indexed_by<name("bymachine"),    const_mem_fun<Process, IndexKey,    &Process::by_machine>>
     > process_table;
+#endif
 
     typedef multi_index<eosio::name("product"), Product,
-      indexed_by<name("byid"),        const_mem_fun<Product, checksum256, &Product::by_id>>
+      indexed_by<name("byid"),        const_mem_fun<Product, IndexKey,    &Product::by_id>>
     > product_table;
     typedef multi_index<eosio::name("recipe"), Recipe,
-      indexed_by<name("bycompandid"), const_mem_fun<Recipe, checksum256, &Recipe:: by_company_and_id>>,
-      indexed_by<name("bycompany"),   const_mem_fun<Recipe, checksum256, &Recipe:: by_company>>
+      indexed_by<name("bycompandid"), const_mem_fun<Recipe, IndexKey,    &Recipe:: by_company_and_id>>,
+      indexed_by<name("bycompany"),   const_mem_fun<Recipe, IndexKey,    &Recipe:: by_company>>
     > recipe_table;
     typedef multi_index<eosio::name("site"), Site,
-      indexed_by<name("byid"),        const_mem_fun<Site, checksum256, &Site::by_id>>,
-      indexed_by<name("bycompany"),   const_mem_fun<Site, checksum256, &Site::by_company>>
+      indexed_by<name("byid"),        const_mem_fun<Site, IndexKey,    &Site::by_id>>,
+      indexed_by<name("bycompany"),   const_mem_fun<Site, IndexKey,    &Site::by_company>>
     > site_table;
     typedef multi_index<eosio::name("user"), User,
-      indexed_by<name("byid"),        const_mem_fun<User, checksum256, &User::by_id>>,
-      indexed_by<name("bycompandid"), const_mem_fun<User, checksum256, &User::by_company_and_user_id>>,
-      indexed_by<name("bycompany"),   const_mem_fun<User, checksum256, &User::by_company>>,
-      indexed_by<name("byfullname"),  const_mem_fun<User, checksum256, &User::by_fullname>>,
-      indexed_by<name("byemail"),     const_mem_fun<User, checksum256, &User::by_email>>
+      indexed_by<name("byid"),        const_mem_fun<User, IndexKey,    &User::by_id>>,
+      indexed_by<name("bycompandid"), const_mem_fun<User, IndexKey,    &User::by_company_and_user_id>>,
+      indexed_by<name("bycompany"),   const_mem_fun<User, IndexKey,    &User::by_company>>,
+      indexed_by<name("byfullname"),  const_mem_fun<User, IndexKey,    &User::by_fullname>>,
+      indexed_by<name("byemail"),     const_mem_fun<User, IndexKey,    &User::by_email>>
     > user_table;
+    typedef multi_index<eosio::name("symbol"), Symbol,
+      indexed_by<name("byvalue"),     const_mem_fun<Symbol, IndexKey,    &Symbol::by_value>>
+    > symbol_table;
+    typedef multi_index<eosio::name("counter"), Counter> counter_table;
+    typedef multi_index<eosio::name("job"), Job,
+      indexed_by<name("bystatus"),   const_mem_fun<Job, uint128_t, &Job::by_status>>,
+      indexed_by<name("bytarget"),   const_mem_fun<Job, uint128_t, &Job::by_target>>
+    > job_table;
+    typedef multi_index<eosio::name("logpartition"), LogPartition> log_partition_table;
+    typedef multi_index<eosio::name("balance"), Balance,
+      indexed_by<name("bysiteprod"),  const_mem_fun<Balance, IndexKey,    &Balance::by_site_and_product>>
+    > balance_table;
+    typedef multi_index<eosio::name("intransit"), InTransit,
+      indexed_by<name("byproduct"),   const_mem_fun<InTransit, IndexKey,  &InTransit::by_product>>
+    > in_transit_table;
+    typedef multi_index<eosio::name("logrollup"), LogRollup,
+      indexed_by<name("bydaygroup"),  const_mem_fun<LogRollup, IndexKey,    &LogRollup::by_day_group>>
+    > log_rollup_table;
+    typedef multi_index<eosio::name("rollupcursor"), RollupCursor> rollup_cursor_table;
+    typedef multi_index<eosio::name("transaction"), Transaction,
+      indexed_by<name("bytxid"),      const_mem_fun<Transaction, checksum256, &Transaction::by_txid>>
+    > transaction_table;
 
+    balance_table       _balances;
     company_table       _companies;
     delivery_table      _deliveries;
-    inventory_log_table _inventory_logs;
+    delivery_line_table _delivery_lines;
+    in_transit_table    _in_transit;
+    log_partition_table _log_partitions;
+    log_rollup_table    _log_rollups;
+    rollup_cursor_table _rollup_cursor;
     item_table          _items;
+    job_table           _jobs;
     machine_table       _machines;
     process_table       _processes;
     product_table       _products;
     recipe_table        _recipes;
     site_table          _sites;
+    symbol_table        _symbols;
     user_table          _users;
 
+    // Writes an InventoryLog row from the action that changed the item
+    void log_inventory( const std::string& user,
+                        const std::string& company,
+                        const std::string& item,
+                        const std::string& site,
+                        const std::string& product,
+                        const std::string& delivery,
+                        const std::string& action,
+                        const std::string& parentAction,
+                        const std::string& parentActionId,
+                        const time_point&  timestamp,
+                        const double&      oldQuantity,
+                        const double&      newQuantity );
+#ifdef TRACELYTICS_LOG_NOTIFY
+    std::vector<InventoryLogNotice> _log_notices;
+    void send_log_notices();
+#endif
+
+    // Log partition written by this action
+    optional<inventory_log_table> _inventory_logs;
+    inventory_log_table& log_partition(const time_point& timestamp);
+    uint32_t clear_logs(uint32_t max_rows);
+    uint32_t purge_logs(uint64_t company, Job& job, uint32_t max_rows);
+    uint32_t clear_partition(uint64_t period, uint32_t max_rows);
+
+    // Transaction table row of the current transaction per partition, looked up once per action
+    optional<checksum256> _txid;
+    std::map<uint64_t, uint64_t> _transactions;
+    uint64_t transaction_index(uint64_t period);
+
+    // Primary key counters used by this action, per (table, scope): read on first use and saved
+    // by the destructor, so emplaces never look for the end of the table. Keys are not reused.
+    struct NextIndex {
+      uint64_t next;
+      uint64_t stored;
+    };
+    std::map<std::pair<uint64_t, uint64_t>, NextIndex> _next_indexes;
+    void save_indexes();
+
+    // Hands out the next primary key of `table`. A table without a counter yet starts after
+    // its last row (and no lower than `first`).
+    template <name::raw TableName, typename T, typename... Indices>
+    uint64_t next_index(const multi_index<TableName, T, Indices...>& table, uint64_t first = 0) {
+      auto [itr, added] = _next_indexes.try_emplace({ static_cast<uint64_t>(TableName), table.get_scope() });
+      auto& counter = itr->second;
+      if (added) {
+        counter_table counters(get_self(), table.get_scope());
+        auto row = counters.find(static_cast<uint64_t>(TableName));
+        counter.stored = row != counters.end() ? row->next : 0;
+        counter.next   = row != counters.end() ? row->next : std::max(table.available_primary_key(), first);
+      }
+      return counter.next++;
+    }
+
+    // Handles interned during this action
+    std::map<std::string, uint64_t> _interned;
+    uint64_t intern(const std::string& value);
+
     void ec_verify(std::string data, const signature &sig, const public_key &pk);
     void verify_auth(std::string company, std::string username, std::string entity, std::string action, std::string verifydata);
     std::vector<std::string> split(std::string str, std::string token);
     std::string to_hex(const char* d, uint32_t s);
     std::string checksum_to_hex(const checksum256& cs);
-    static uint64_t truncate_sha256_to_uint64(const checksum256& sha256);
+
+    // Item mutations shared by the item actions, processes and deliveries
+    const Item& create_item( const std::string& user,
+                             const std::string& company,
+                             const std::string& site,
+                             const std::string& itemId,
+                             const std::string& product,
+                             const double& quantity,
+                             const std::map<std::string, std::string>& metadata,
+                             const std::string& action,
+                             const std::string& actionId,
+                             const time_point& timestamp );
+    void update_item( const Item& item,
+                      const std::string& user,
+                      const double& quantity,
+                      const std::map<std::string, std::string>& metadata,
+                      const std::string& action,
+                      const std::string& actionId,
+                      const time_point& timestamp,
+                      const optional<std::string_view>& product  = std::nullopt,
+                      const optional<std::string_view>& delivery = std::nullopt,
+                      const optional<std::string_view>& version  = std::nullopt );
 
     inline void upsertitem(
       const std::string& user,
@@ -727,47 +1018,110 @@ CONTRACT tracelytics : public contract {
       const std::string& item,
       const std::string& product,
       const double& delta,
-      std::map<std::string, std::string> metadata,
+      const std::map<std::string, std::string>& metadata,
       const std::string& action,
       const std::string& actionId,
       const time_point& timestamp
     );
 
-    Site check_site_exists (const std::string& company, const std::string& site);
+    // Sites looked up by this action, by site ID
+    std::map<std::string, Site> _loaded_sites;
+    const Site& check_site_exists (const std::string& company, const std::string& site);
+
+    // Unit of work for items moved by deliveries: each row is loaded once, changed in memory
+    // however often the action moves it, and written once by commit_items()
+    std::map<std::string, Item> _pending_items;
+    Item& pending_item (const std::string& itemId);
+    const Item* find_item (const std::string& itemId);
+    Item& split_item (Item& parent,
+                      const std::string& baseId,
+                      const double& quantity,
+                      const std::string& user,
+                      const std::string& action,
+                      const std::string& actionId,
+                      const time_point& timestamp);
+    void commit_items ();
+
+    // Balance changes of this action, added up per row and saved by the destructor. Every change
+    // to an item's quantity, site, company, product or delivery calls track_balance on the row
+    // before (-1) and after (+1).
+    std::map<std::tuple<std::string, std::string, std::string>, double> _balance_deltas;
+    std::map<std::pair<std::string, std::string>, double> _in_transit_deltas;
+    void track_balance (const Item& item, double sign);
+    void save_balances ();
 
     // Process
     inline void processcargo (
-      Process& entity,
-      std::map<std::string, ProductQuantity>& cargo,
-      const std::map<std::string, ProductQuantity>& cargoDeltas,
+      const Process& entity,
+      CargoLines& cargo,
+      const CargoLines& cargoDeltas,
       const std::string& user,
       const std::string& company,
       const std::string& action,
-      const std::string& activity
+      uint8_t activity
     );
     inline InventoryDelta inventoryDeltaForCargo (
       const Process& entity,
       const ProductQuantity& productAndQuantity,
-      const std::string& activity
+      uint8_t activity
     );
+    // Jobs
+    static constexpr uint32_t JOB_INLINE_STEPS = 100;
+    void start_job (uint8_t type, uint64_t target, const time_point& timestamp, uint32_t max_steps = JOB_INLINE_STEPS);
+    uint32_t run_job (Job& job, uint32_t max_steps);
+    // Whether a job's line can be moved or refunded without failing the action
+    bool can_move (const std::string& item, const ProductQuantity& productAndQuantity);
+    bool can_refund (const Process& process, const std::string& item, const ProductQuantity& productAndQuantity);
+
+    // Clearing and purge jobs. A stage returns the steps it took, fewer than max_rows once it is done.
+    std::vector<uint8_t> clear_stages (const Job& job);
+    uint32_t clear_stage (uint8_t stage, const Job& job, uint32_t max_rows);
+    uint32_t purge_stage (uint8_t stage, const std::string& company, Job& job, uint32_t max_rows);
+    uint32_t purge_deliveries (const std::string& company, Job& job, uint32_t max_rows);
+
+    // Erases the rows `matches` picks, examining up to max_rows rows from the cursor (primary key)
+    template <typename Table, typename Matches>
+    uint32_t purge_scan (Table& table, uint64_t& cursor, Matches&& matches, uint32_t max_rows) {
+      uint32_t rows = 0;
+      auto itr = table.lower_bound(cursor);
+      for (; itr != table.end() && rows < max_rows; ++rows) {
+        if (matches(*itr)) {
+          itr = table.erase(itr);
+        } else {
+          ++itr;
+        }
+      }
+      if (itr != table.end()) cursor = itr->primary_key();
+      return rows;
+    }
+
+    // Same for the rows under one key of a secondary index, which are in primary key order. Rows
+    // that only share the key by hash collision are kept, and the cursor moves past them.
+    template <typename Index, typename Matches>
+    uint32_t purge_key (Index& index, const IndexKey& key, uint64_t& cursor, Matches&& matches, uint32_t max_rows) {
+      uint32_t rows = 0;
+      auto last = index.upper_bound(key);
+      auto itr  = index.lower_bound(key);
+      while (itr != last && itr->primary_key() < cursor) ++itr; // Examined by earlier calls
+      for (; itr != last && rows < max_rows; ++rows) {
+        if (matches(*itr)) {
+          itr = index.erase(itr);
+        } else {
+          ++itr;
+        }
+      }
+      if (itr != last) cursor = itr->primary_key();
+      return rows;
+    }
+
     // Delivery
+    void set_cargo_line (uint64_t delivery, const std::string& item, const ProductQuantity& productAndQuantity);
+    void erase_cargo_line (uint64_t delivery, const std::string& item);
+    uint32_t erase_cargo (uint64_t delivery, uint32_t max_lines);
     inline void processDelivery (
-      Delivery& entity,
-      std::map<std::string, ProductQuantity>& cargo,
-      const std::string& activity,
+      const Delivery& entity,
+      CargoLines& cargo,
+      uint8_t activity,
       const std::string& deliveryAction
     );
 };
-
-namespace Checksum
-{
-  inline eosio::checksum256 COMPANY (std::string companyId)                      { return tracelytics::SHA256(companyId); }
-  inline eosio::checksum256 MACHINE (std::string company, std::string machineId) { return tracelytics::SHA256(company + ";" + machineId); }
-  inline eosio::checksum256 PROCESS (std::string company, std::string processId) { return tracelytics::SHA256(company + ";" + processId); }
-  inline eosio::checksum256 PRODUCT (std::string productId)                      { return tracelytics::SHA256(productId); }
-  inline eosio::checksum256 RECIPE  (std::string company, std::string recipeId)  { return tracelytics::SHA256(company + ";" + recipeId); }
-  inline eosio::checksum256 SITE    (std::string siteId)                         { return tracelytics::SHA256(siteId); }
-  inline eosio::checksum256 USER    (std::string userId)                         { return tracelytics::SHA256(userId); }
-  inline eosio::checksum256 DELIVERY(std::string deliveryId, std::string route)  { return tracelytics::SHA256(deliveryId + ";" + route); }
-  inline eosio::checksum256 ITEM    (std::string itemId)                         { return tracelytics::SHA256(itemId); }
-}
\ No newline at end of file
@@ -1,77 +1,93 @@
 #pragma once
 
 void tracelytics::processDelivery (
-  Delivery& entity,
-  std::map<std::string, ProductQuantity>& cargo,
-  const std::string& activity,
+  const Delivery& entity,
+  CargoLines& cargo,
+  uint8_t activity,
   const std::string& deliveryAction
 ) {
-  // Item index
-  auto items_byid = _items.get_index<eosio::name("byid")>();
+  // Cargo lines that now refer to a split-off child item, renamed after the loop
+  std::vector<std::pair<std::string, std::string>> splits;
 
   for( auto const& [item, productAndQuantity] : cargo ) {
-    // 1. Edit the cargo
+    // 1. Adding or removing cargo
     bool addCargo = activity == DeliveryActivity::EDIT_CARGO && productAndQuantity.quantity > 0;
     bool removeCargo = activity == DeliveryActivity::EDIT_CARGO && productAndQuantity.quantity == 0;
-    if (addCargo) {
-      entity.cargo[item] = productAndQuantity;
-    } else if (removeCargo) {
-      entity.cargo.erase(item);
-    }
 
     // 2. Validate item
-    // 2.1 Check item exists
-    auto existing_item = items_byid.find(Checksum::ITEM(item));
-    check(existing_item != items_byid.end(), "item " + item + " does not exist");
+    // 2.1 Check item exists (written by commit_items)
+    auto* i = &pending_item(item);
     // 2.2 Items have a positive quantity
-    check(existing_item->quantity > 0, "item " + item + " has a quantity of " + to_string(existing_item->quantity) + ", must be positive to transfer.");
-    // 2.3 Check item quantity is transferring ALL or removing cargo
-    check(existing_item->quantity == productAndQuantity.quantity || removeCargo, "Trying to transfer " + to_string(productAndQuantity.quantity) + " of " + item + ", but must send " + to_string(existing_item->quantity) + ". Please split items into 2 tags if you wish to send partial quantity.");
+    check(i->quantity > 0, "item " + item + " has a quantity of " + to_string(i->quantity) + ", must be positive to transfer.");
+    // 2.3 Sending may take part of the item, everything else moves the whole item
+    if (activity == DeliveryActivity::SEND_DELIVERY || addCargo) {
+      check(productAndQuantity.quantity > 0 && productAndQuantity.quantity <= i->quantity, "Trying to transfer " + to_string(productAndQuantity.quantity) + " of " + item + ", which has " + to_string(i->quantity) + ".");
+      // An item already in transit travels whole: its cargo line cannot be lowered
+      check(i->delivery.empty() || productAndQuantity.quantity == i->quantity, "item " + item + " is on delivery " + i->delivery + " with " + to_string(i->quantity) + ", which cannot be changed.");
+    } else {
+      check(i->quantity == productAndQuantity.quantity || removeCargo, "Trying to transfer " + to_string(productAndQuantity.quantity) + " of " + item + ", but must send " + to_string(i->quantity) + ".");
+    }
+
+    // 2.4 Partial quantity of an item at a site: split the sent quantity off into a child item, which travels instead
+    if (productAndQuantity.quantity < i->quantity && !removeCargo && i->delivery.empty()) {
+      i = &split_item(*i, item + "#" + entity.deliveryId, productAndQuantity.quantity, entity.updatedBy, deliveryAction, entity.deliveryId, entity.updatedAt);
+      splits.emplace_back(item, i->itemId);
+    }
 
     // 3. Modify item to reflect state
-    items_byid.modify(existing_item, same_payer, [&](auto& i){
-      i.updatedAt = entity.updatedAt;
-      i.updatedBy = entity.updatedBy;
+    i->updatedAt = entity.updatedAt;
+    i->updatedBy = entity.updatedBy;
 
-      // 3a. Sending delivery/ Add to cargo: Move to delivery mode
-      if (activity == DeliveryActivity::SEND_DELIVERY || addCargo) {
-        i.company  = entity.fromCompany + " -> " + entity.toCompany;
-        i.site     = entity.fromSite + " -> " + entity.toSite;
-        i.delivery = entity.deliveryId;
+    // 3a. Sending delivery/ Add to cargo: Move to delivery mode
+    if (activity == DeliveryActivity::SEND_DELIVERY || addCargo) {
+      i->company  = entity.fromCompany + " -> " + entity.toCompany;
+      i->site     = entity.fromSite + " -> " + entity.toSite;
+      i->delivery = entity.deliveryId;
 
-      // 3b. Receive delivery: Credit to receiver
-      } else if (activity == DeliveryActivity::RECEIVE_DELIVERY) {
-        i.company  = entity.toCompany;
-        i.site     = entity.toSite;
-        i.delivery = (std::string) "";
+    // 3b. Receive delivery: Credit to receiver
+    } else if (activity == DeliveryActivity::RECEIVE_DELIVERY) {
+      i->company  = entity.toCompany;
+      i->site     = entity.toSite;
+      i->delivery = (std::string) "";
 
-      // 3c. Cancel delivery/Remove cargo: Credit to sender
-      } else if (activity == DeliveryActivity::CANCEL_DELIVERY || removeCargo) {
-        i.company  = entity.fromCompany;
-        i.site     = entity.fromSite;
-        i.delivery = (std::string) "";
+    // 3c. Cancel delivery/Remove cargo: Credit to sender
+    } else if (activity == DeliveryActivity::CANCEL_DELIVERY || removeCargo) {
+      i->company  = entity.fromCompany;
+      i->site     = entity.fromSite;
+      i->delivery = (std::string) "";
 
-      // 3d. Error
-      } else {
-        check(false, "not of type send delivery, receive delivery or cancel delivery.");
-      }
+    // 3d. Error
+    } else {
+      check(false, "not of type send delivery, receive delivery or cancel delivery.");
+    }
+
+    // 4. Keep the delivery's cargo lines (only the ones sent, added or removed)
+    if (activity == DeliveryActivity::SEND_DELIVERY || addCargo) {
+      set_cargo_line(entity.index, i->itemId, productAndQuantity);
+      if (i->itemId != item) erase_cargo_line(entity.index, item);
+    } else if (removeCargo) {
+      erase_cargo_line(entity.index, item);
+    }
+
+    // Log the change
+    log_inventory(i->updatedBy,
+                  i->company,
+                  i->itemId,
+                  i->site,
+                  i->product,
+                  i->delivery,
+                  (std::string) "edititem",
+                  deliveryAction,
+                  entity.deliveryId,
+                  entity.updatedAt,
+                  i->quantity,
+                  i->quantity);
+  }
 
-      // Log the change
-      tracelytics::loginventory_action loginventory_action( get_self(), {get_self(), "active"_n} );
-      loginventory_action.send(i.updatedBy,
-                               i.company,
-                               i.itemId,
-                               i.site,
-                               i.product,
-                               i.delivery,
-                               i.metadata,
-                               (std::string) "edititem",
-                               deliveryAction,
-                               entity.deliveryId,
-                               entity.updatedAt,
-                               i.version,
-                               i.quantity,
-                               i.quantity);
-    });
+  // Point the cargo at the split-off items (a delivery sent and received at once receives these)
+  for (const auto& [parent, child] : splits) {
+    auto line = Cargo::find(cargo, parent);
+    if (line != cargo.end()) line->first = child;
   }
+  if (!splits.empty()) Cargo::normalize(cargo);
 };
\ No newline at end of file
@@ -0,0 +1,265 @@
+#pragma once
+
+/**
+ * Secondary index keys
+ *
+ * Every secondary index hashes one or more ";"-joined string fields. The
+ * strategy is chosen at compile time:
+ *  - default:                64-bit FNV-1a (with a murmur finalizer), stored as uint64
+ *  - TRACELYTICS_KEY_SHA256: full SHA256, stored as checksum256
+ *
+ * 64-bit keys can collide, so lookups by ID go through find_by_key, which
+ * compares the stored fields of the row it lands on.
+ **/
+
+#include <array>
+#include <cstring>
+#include <map>
+#include <string_view>
+
+#if defined(TRACELYTICS_KEY_SHA256)
+typedef checksum256 IndexKey;
+#else
+typedef uint64_t IndexKey;
+#endif
+
+namespace Key
+{
+  inline uint64_t truncate_sha256_to_uint64(const checksum256& sha256) {
+    auto array = sha256.extract_as_byte_array();
+    uint64_t value =
+      static_cast<uint64_t>(array[0]) |
+      static_cast<uint64_t>(array[1]) << 8 |
+      static_cast<uint64_t>(array[2]) << 16 |
+      static_cast<uint64_t>(array[3]) << 24 |
+      static_cast<uint64_t>(array[4]) << 32 |
+      static_cast<uint64_t>(array[5]) << 40 |
+      static_cast<uint64_t>(array[6]) << 48 |
+      static_cast<uint64_t>(array[7]) << 56;
+
+    return value;
+  }
+
+  /**
+   * Keys are hashed straight from the fields, as if they were joined with ";",
+   * without building the joined string: FNV-1a streams over the fields, and
+   * SHA256 copies them into a fixed stack buffer (the heap is only used for
+   * keys longer than KEY_BUFFER).
+   **/
+  namespace detail {
+    static constexpr size_t KEY_BUFFER = 256;
+
+    inline uint64_t fnv1a64(uint64_t hash, std::string_view data) {
+      for (char c : data) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 0x100000001b3ull;
+      }
+      return hash;
+    }
+
+    template <size_t N>
+    uint64_t fnv(const std::array<std::string_view, N>& fields) {
+      uint64_t hash = 0xcbf29ce484222325ull;
+      for (size_t i = 0; i < N; ++i) {
+        if (i) hash = fnv1a64(hash, ";");
+        hash = fnv1a64(hash, fields[i]);
+      }
+
+      // Finalizer (MurmurHash3 fmix64) so short, similar IDs spread over the whole range
+      hash ^= hash >> 33;
+      hash *= 0xff51afd7ed558ccdull;
+      hash ^= hash >> 33;
+      hash *= 0xc4ceb9fe1a85ec53ull;
+      hash ^= hash >> 33;
+      return hash;
+    }
+
+    template <size_t N>
+    checksum256 sha(const std::array<std::string_view, N>& fields) {
+      size_t size = N ? N - 1 : 0;
+      for (const auto& field : fields) size += field.size();
+
+      char stack[KEY_BUFFER];
+      std::string heap;
+      char* buffer = stack;
+      if (size > KEY_BUFFER) {
+        heap.resize(size);
+        buffer = &heap[0];
+      }
+
+      char* out = buffer;
+      for (size_t i = 0; i < N; ++i) {
+        if (i) *out++ = ';';
+        memcpy(out, fields[i].data(), fields[i].size());
+        out += fields[i].size();
+      }
+      return sha256(buffer, size);
+    }
+
+    template <size_t N>
+    IndexKey key(const std::array<std::string_view, N>& fields) {
+#if defined(TRACELYTICS_KEY_SHA256)
+      return sha(fields);
+#else
+      return fnv(fields);
+#endif
+    }
+
+    template <size_t N>
+    uint64_t key64(const std::array<std::string_view, N>& fields) {
+#if defined(TRACELYTICS_KEY_SHA256)
+      return truncate_sha256_to_uint64(sha(fields));
+#else
+      return fnv(fields);
+#endif
+    }
+  }
+
+  template <typename... Fields>
+  IndexKey hash(const Fields&... fields) {
+    return detail::key(std::array<std::string_view, sizeof...(Fields)>{ std::string_view(fields)... });
+  }
+
+  // 64-bit prefix for composite uint128 keys (key << 64 | time)
+  template <typename... Fields>
+  uint64_t hash64(const Fields&... fields) {
+    return detail::key64(std::array<std::string_view, sizeof...(Fields)>{ std::string_view(fields)... });
+  }
+
+  /**
+   * Keys over interned handles (non-zero, below 2^32): packed exactly where
+   * they fit, so no hashing at all. Three handles do not fit a uint64 and are
+   * mixed instead, which find_by_key-style comparisons have to tolerate.
+   **/
+  template <typename... Handles>
+  IndexKey pack(Handles... handles) {
+    constexpr size_t N = sizeof...(Handles);
+    const std::array<uint64_t, N> values = { static_cast<uint64_t>(handles)... };
+#if defined(TRACELYTICS_KEY_SHA256)
+    static_assert(N <= 4, "at most four handles per key");
+    std::array<uint8_t, 32> bytes = {};
+    for (size_t i = 0; i < N; ++i) {
+      for (int b = 0; b < 8; ++b) bytes[i * 8 + 7 - b] = static_cast<uint8_t>(values[i] >> (8 * b));
+    }
+    return checksum256(bytes);
+#else
+    if constexpr (N == 1) return values[0];
+    else if constexpr (N == 2) return values[0] << 32 | values[1];
+    else return detail::fnv(std::array<std::string_view, 1>{ std::string_view(reinterpret_cast<const char*>(values.data()), sizeof(values)) });
+#endif
+  }
+
+  /**
+   * Keys of rows that are modified in place.
+   *
+   * multi_index::modify calls every key extractor before and after the
+   * updater, although most edits only touch quantity and updatedAt. With
+   * SHA256 keys each extractor keeps, per primary key, a copy of its source
+   * fields and the key built from them, and only rehashes once one of those
+   * fields changed. In wasm the cache lives for a single action.
+   *
+   * 64-bit keys are recomputed every time: streaming FNV over a few short
+   * fields costs less than the lookup and the field copies the memo needs.
+   **/
+  namespace detail {
+#if defined(TRACELYTICS_KEY_SHA256)
+    template <typename Result, size_t N>
+    struct memo_entry {
+      std::array<std::string, N> fields;
+      Result key;
+    };
+
+    template <auto Extractor, typename Result, typename Compute, typename... Fields>
+    Result memoize(uint64_t id, Compute&& compute, const Fields&... fields) {
+      constexpr size_t N = sizeof...(Fields);
+      static std::map<uint64_t, memo_entry<Result, N>> entries;
+
+      const std::array<std::string_view, N> current = { std::string_view(fields)... };
+      auto itr = entries.find(id);
+      if (itr == entries.end()) {
+        itr = entries.emplace(id, memo_entry<Result, N>{}).first;
+      } else {
+        bool unchanged = true;
+        for (size_t i = 0; i < N && unchanged; ++i) unchanged = std::string_view(itr->second.fields[i]) == current[i];
+        if (unchanged) return itr->second.key;
+      }
+
+      for (size_t i = 0; i < N; ++i) itr->second.fields[i].assign(current[i].data(), current[i].size());
+      return itr->second.key = compute(current);
+    }
+#else
+    template <auto Extractor, typename Result, typename Compute, typename... Fields>
+    Result memoize(uint64_t, Compute&& compute, const Fields&... fields) {
+      return compute(std::array<std::string_view, sizeof...(Fields)>{ std::string_view(fields)... });
+    }
+#endif
+  }
+
+  template <auto Extractor, typename... Fields>
+  IndexKey cached(uint64_t id, const Fields&... fields) {
+    return detail::memoize<Extractor, IndexKey>(id, [](const auto& current) { return detail::key(current); }, fields...);
+  }
+
+  template <auto Extractor, typename... Fields>
+  uint64_t cached64(uint64_t id, const Fields&... fields) {
+    return detail::memoize<Extractor, uint64_t>(id, [](const auto& current) { return detail::key64(current); }, fields...);
+  }
+
+  /**
+   * Sparse indexes
+   *
+   * multi_index stores every row in every index, so a row whose key field is
+   * empty cannot be left out. Instead it gets a key of its own, derived from
+   * its primary key, in a range no hashed key falls into: hashed uint64 keys
+   * have the top bit set, and a SHA256 key with 24 leading zero bytes does not
+   * occur. Empty rows then stay out of the buckets that queries look at
+   * instead of piling up in one hot bucket for "".
+   **/
+  inline IndexKey absent(uint64_t id) {
+#if defined(TRACELYTICS_KEY_SHA256)
+    std::array<uint8_t, 32> bytes = {};
+    for (int i = 0; i < 8; ++i) bytes[31 - i] = static_cast<uint8_t>(id >> (8 * i));
+    return checksum256(bytes);
+#else
+    return id & ~(1ull << 63);
+#endif
+  }
+
+  inline IndexKey present(const IndexKey& key) {
+#if defined(TRACELYTICS_KEY_SHA256)
+    return key;
+#else
+    return key | (1ull << 63);
+#endif
+  }
+
+  template <auto Extractor, typename... Fields>
+  IndexKey sparse(uint64_t id, bool empty, const Fields&... fields) {
+    return empty ? absent(id) : present(cached<Extractor>(id, fields...));
+  }
+
+  inline IndexKey COMPANY (std::string_view companyId)                           { return hash(companyId);             }
+  inline IndexKey MACHINE (std::string_view company, std::string_view machineId) { return hash(company, machineId);    }
+  inline IndexKey PROCESS (std::string_view company, std::string_view processId) { return hash(company, processId);    }
+  inline IndexKey PRODUCT (std::string_view productId)                           { return hash(productId);             }
+  inline IndexKey RECIPE  (std::string_view company, std::string_view recipeId)  { return hash(company, recipeId);     }
+  inline IndexKey SITE    (std::string_view siteId)                              { return hash(siteId);                }
+  inline IndexKey USER    (std::string_view userId)                              { return hash(userId);                }
+  inline IndexKey DELIVERY(std::string_view deliveryId, std::string_view route)  { return hash(deliveryId, route);     }
+  inline IndexKey ITEM    (std::string_view itemId)                              { return hash(itemId);                }
+
+  /**
+   * Finds the row with `key` in `index` for which `matches(row)` holds.
+   * Only walks past the first row on a hash collision.
+   **/
+  template <typename Index, typename Matches>
+  auto find_by_key(const Index& index, const IndexKey& key, Matches&& matches) {
+    auto itr = index.find(key);
+    if (itr == index.end() || matches(*itr)) return itr;
+
+    for (auto last = index.upper_bound(key); itr != last; ++itr) {
+      if (matches(*itr)) return itr;
+    }
+    return index.end();
+  }
+}
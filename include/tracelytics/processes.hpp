@@ -13,7 +13,7 @@
 InventoryDelta tracelytics::inventoryDeltaForCargo (
   const Process& entity,
   const ProductQuantity& productAndQuantity,
-  const std::string& activity
+  uint8_t activity
 ) {
   double inventoryDelta = 0;
 
@@ -39,51 +39,22 @@ InventoryDelta tracelytics::inventoryDeltaForCargo (
 **/
 
 void tracelytics::processcargo (
-  Process& entity,
-  std::map<std::string, ProductQuantity>& cargo,
-  const std::map<std::string, ProductQuantity>& cargoDeltas,
+  const Process& entity,
+  CargoLines& cargo,
+  const CargoLines& cargoDeltas,
   const std::string& user,
   const std::string& company,
   const std::string& action,
-  const std::string& activity
+  uint8_t activity
 ) {
-  bool isDeltas = cargoDeltas.size() > 0;
-  auto deltasOrCargo = isDeltas ? cargoDeltas : cargo;
-
-  for( auto const& [item, productAndQuantity] : deltasOrCargo ) {
-    InventoryDelta inventoryDelta;
-
-    // 1. Validate quantity
+  // 1. Validate quantity
+  auto validate = [](const std::string& item, const ProductQuantity& productAndQuantity) {
     check(productAndQuantity.quantity >= 0, "quantity in delivery must be zero or positive for item " + item);
+  };
 
-    // 2. Get inventory delta
-    if (isDeltas) {
-      auto inventoryDeltaQuantity = cargo.count(item) > 0
-        ? cargo[item].quantity - productAndQuantity.quantity
-        : -productAndQuantity.quantity;
-
-      inventoryDelta = InventoryDelta {
-        inventoryDeltaQuantity,
-        entity.site,
-        entity.company
-      };
-    } else {
-      inventoryDelta = inventoryDeltaForCargo(entity, productAndQuantity, activity);
-    }
-
-    // 3. Update cargo with new quantities if processing deltas
-    if (isDeltas) {
-      // 3a. Erase if 0
-      if (productAndQuantity.quantity == 0) {
-        cargo.erase(item);
-      // 3b. Set if positive
-      } else {
-        cargo[item] = productAndQuantity;
-      }
-    }
-
-    // 4. Update item quantities
-    // Skip if delta is 0 and if not editing outputs for a process
+  // 2. Update item quantities
+  // Skip if delta is 0 and if not editing outputs for a process
+  auto apply = [&](const std::string& item, const ProductQuantity& productAndQuantity, const InventoryDelta& inventoryDelta) {
     if (inventoryDelta.quantity != 0 && activity != ProcessActivity::EDIT_OUTPUTS) {
       upsertitem(user,
                  inventoryDelta.company,
@@ -93,9 +64,23 @@ void tracelytics::processcargo (
                  inventoryDelta.quantity,
                  productAndQuantity.metadata,
                  action,
-                 entity.id(),
+                 entity.processId,
                  entity.updatedAt);
     }
+  };
+
+  // Deltas: merged into cargo in one pass, each charging or refunding the site the difference
+  if (cargoDeltas.size() > 0) {
+    Cargo::merge(cargo, cargoDeltas, [&](const std::string& item, const ProductQuantity& productAndQuantity, double oldQuantity) {
+      validate(item, productAndQuantity);
+      apply(item, productAndQuantity, InventoryDelta { oldQuantity - productAndQuantity.quantity, entity.site, entity.company });
+    });
+    return;
+  }
+
+  for( auto const& [item, productAndQuantity] : cargo ) {
+    validate(item, productAndQuantity);
+    apply(item, productAndQuantity, inventoryDeltaForCargo(entity, productAndQuantity, activity));
   }
 };
 
@@ -109,17 +94,16 @@ void tracelytics::upsertitem (
     const std::string& item,
     const std::string& product,
     const double& delta,
-    std::map<std::string, std::string> metadata,
+    const std::map<std::string, std::string>& metadata,
     const std::string& action,
     const std::string& actionId,
     const time_point& timestamp
 ) {
+    check(!item.empty(), "item ID is missing.");
+
     // Existing item
     auto items_byid = _items.get_index<eosio::name("byid")>();
-    auto existing_item = items_byid.find(Checksum::ITEM(item));
-
-    // Empty call data
-    std::map<std::string, std::string> call_data;
+    auto existing_item = Key::find_by_key(items_byid, Key::ITEM(item), [&](const auto& row) { return row.itemId == item; });
 
     // Item exists
     if (existing_item != items_byid.end()) {
@@ -131,38 +115,18 @@ void tracelytics::upsertitem (
                                                     to_string(existing_item->quantity) + " " + item +
                                                     "(" + product + "), you are trying to use " + to_string(-delta));
 
-        tracelytics::edititem_action edititem_action( get_self(), {get_self(), eosio::name("active")} );
-        edititem_action.send(user,
-                             company,
-                             site,
-                             item,
-                             metadata,
-                             action,
-                             actionId,
-                             timestamp,
-                             call_data,
-                             std::nullopt,
-                             delta,
-                             product,
-                             std::nullopt,
-                             std::nullopt);
+        if (user != ADMIN) {
+            check(company == existing_item->company, "only employees of " + existing_item->company + " can edit item " + item + ". Current user is from" + company + ".");
+        }
+
+        update_item(*existing_item, user, existing_item->quantity + delta, metadata, action, actionId, timestamp, product);
     // Item does not exist (create it)
     } else {
         // Make sure we are not trying to create with negative delta
         check(delta > 0, "Item " + item + " does not exist at site " + site + ". Please create it first.");
+        check(!product.empty(), "product is missing.");
+        check_site_exists(company, site);
 
-        tracelytics::newitem_action newitem_action( get_self(), {get_self(), eosio::name("active")} );
-        newitem_action.send( user,
-                             company,
-                             site,
-                             item,
-                             product,
-                             delta,
-                             metadata,
-                             action,
-                             actionId,
-                             timestamp,
-                             call_data,
-                             std::nullopt);
+        create_item(user, company, site, item, product, delta, metadata, action, actionId, timestamp);
     }
 }
@@ -1,8 +1,9 @@
 #pragma once
 
+#define ADMIN std::string("admin")
+
 #include <tracelytics/types.hpp>
+#include <tracelytics/keys.hpp>
 #include <tracelytics/contract.hpp>
 #include <tracelytics/deliveries.hpp>
 #include <tracelytics/processes.hpp>
-
-#define ADMIN std::string("admin")
\ No newline at end of file
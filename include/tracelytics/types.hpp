@@ -7,17 +7,25 @@
 #include <eosio/transaction.hpp>
 #include <eosio/time.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <iterator>
 #include <string>
+#include <string_view>
+#include <tuple>
 #include <variant>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 using namespace eosio;
 using namespace std;
 
+// Refers to the site and company of the entity it was computed for
 struct InventoryDelta {
-  double     quantity;
-  std::string site;
-  std::string company;
+  double             quantity;
+  const std::string& site;
+  const std::string& company;
 };
 struct ProductQuantityBase {
   std::string product;
@@ -28,6 +36,76 @@ struct ProductQuantity: ProductQuantityBase {
   std::map<std::string, std::string> metadata;
 };
 
+/**
+ * Cargo lines (item ID -> product and quantity), sorted by item ID without duplicates
+ *
+ * A flat vector of pairs has the same wire format and ABI type (pair_string_ProductQuantity[])
+ * as std::map<std::string, ProductQuantity>, but loads into a single allocation instead of a
+ * node per line. Lines received as action arguments go through Cargo::normalize.
+ **/
+typedef std::vector<std::pair<std::string, ProductQuantity>> CargoLines;
+
+namespace Cargo
+{
+  // Sorts lines by item ID and rejects items listed twice
+  inline void normalize (CargoLines& lines) {
+    auto byItem = [](const auto& a, const auto& b) { return a.first < b.first; };
+    if (!std::is_sorted(lines.begin(), lines.end(), byItem)) {
+      std::sort(lines.begin(), lines.end(), byItem);
+    }
+
+    auto duplicate = std::adjacent_find(lines.begin(), lines.end(), [](const auto& a, const auto& b) { return a.first == b.first; });
+    if (duplicate != lines.end()) {
+      check(false, "item " + duplicate->first + " is listed more than once.");
+    }
+  }
+
+  // Line of `item`, or end()
+  template <typename Lines>
+  auto find (Lines& lines, std::string_view item) {
+    auto line = std::lower_bound(lines.begin(), lines.end(), item, [](const auto& l, std::string_view i) { return l.first < i; });
+    return line != lines.end() && line->first == item ? line : lines.end();
+  }
+
+  /**
+   * Applies deltas to cargo in one pass over both (each sorted): a delta line replaces the
+   * cargo line of its item, or removes it when its quantity is 0. `visit(item, delta, oldQuantity)`
+   * sees every delta in item order, with the quantity the cargo held before (0 if none).
+   **/
+  template <typename Visit>
+  void merge (CargoLines& cargo, const CargoLines& deltas, Visit&& visit) {
+    CargoLines merged;
+    merged.reserve(cargo.size() + deltas.size());
+
+    auto line = cargo.begin();
+    for (const auto& delta : deltas) {
+      for (; line != cargo.end() && line->first < delta.first; ++line) {
+        merged.push_back(std::move(*line));
+      }
+
+      double oldQuantity = 0;
+      if (line != cargo.end() && line->first == delta.first) {
+        oldQuantity = line->second.quantity;
+        ++line;
+      }
+
+      visit(delta.first, delta.second, oldQuantity);
+      if (delta.second.quantity != 0) merged.push_back(delta);
+    }
+    std::move(line, cargo.end(), std::back_inserter(merged));
+
+    cargo.swap(merged);
+  }
+}
+
+struct InventoryLogNotice {
+  uint64_t    period; // InventoryLog scope (YYYYMM)
+  uint64_t    index;  // InventoryLog row
+  std::string item;
+  double      oldQuantity;
+  double      newQuantity;
+};
+
 // #define all_type std::variant< \
 //   char, \
 //   uint16_t, \
@@ -57,59 +135,102 @@ struct ProductQuantity: ProductQuantityBase {
 //   eosio::extended_asset \
 // >
 
+// Statuses, types and activities are stored and compared as uint8 codes.
+// Their names are only used at the ABI boundary (action arguments) and in index keys.
+// Code 0 (NONE) is the empty string.
+template <size_t N>
+uint8_t code_or (const std::string_view (&names)[N], std::string_view value, uint8_t unknown) {
+  for (uint8_t code = 0; code < N; ++code) {
+    if (names[code] == value) return code;
+  }
+  return unknown;
+}
+
+template <size_t N>
+uint8_t code_of (const std::string_view (&names)[N], std::string_view value, const char* error) {
+  uint8_t code = code_or(names, value, N);
+  check(code < N, error);
+  return code;
+}
+
+template <size_t N>
+std::string_view name_of (const std::string_view (&names)[N], uint8_t code) {
+  check(code < N, "unknown code");
+  return names[code];
+}
+
+// Statuses also take free-form values: those are stored as OTHER, with the string kept in the row
 namespace ProcessStatus
 {
-  const std::string PROCESSING = "processing";
-  const std::string PROCESSED  = "processed";
-  const std::string CANCELLED  = "cancelled";
+  enum : uint8_t { NONE, PROCESSING, PROCESSED, CANCELLED, OTHER = 255 };
+  constexpr std::string_view NAMES[] = { "", "processing", "processed", "cancelled" };
+
+  inline uint8_t parse (std::string_view value)  { return code_or(NAMES, value, OTHER); }
+  inline std::string_view name (uint8_t code)    { return name_of(NAMES, code); }
 }
 namespace ProcessType
 {
-  const std::string PROCESS    = "process";
-  const std::string SPLIT      = "split";
-  const std::string MERGE      = "merge";
-  const std::string ADJUSTMENT = "adjustment";
-  const std::string SCRAP      = "scrap";
+  // Free-form types are stored as OTHER, like statuses
+  enum : uint8_t { NONE, PROCESS, SPLIT, MERGE, ADJUSTMENT, SCRAP, OTHER = 255 };
+  constexpr std::string_view NAMES[] = { "", "process", "split", "merge", "adjustment", "scrap" };
+
+  inline uint8_t parse (std::string_view value)  { return code_or(NAMES, value, OTHER); }
+  inline std::string_view name (uint8_t code)    { return name_of(NAMES, code); }
 }
 namespace ProcessActivity
 {
-  const std::string START_PROCESS  = "Start Process";
-  const std::string EDIT_INPUTS    = "Edit Inputs";
-  const std::string EDIT_OUTPUTS   = "Edit Outputs";
-  const std::string FINISH_PROCESS = "Finish Process";
+  enum : uint8_t { START_PROCESS = 1, EDIT_INPUTS, EDIT_OUTPUTS, FINISH_PROCESS };
 }
 
 namespace DeliveryStatus
 {
-  const std::string CANCELLED = "cancelled";
-  const std::string LOADING   = "loading";
-  const std::string SHIPPED   = "shipped";
-  const std::string DELIVERED = "delivered";
+  // RECEIVING and CANCELLING while a job moves the cargo, then DELIVERED or CANCELLED
+  enum : uint8_t { NONE, CANCELLED, LOADING, SHIPPED, DELIVERED, RECEIVING, CANCELLING, OTHER = 255 };
+  constexpr std::string_view NAMES[] = { "", "cancelled", "loading", "shipped", "delivered", "receiving", "cancelling" };
+
+  inline uint8_t parse (std::string_view value)  { return code_or(NAMES, value, OTHER); }
+  inline std::string_view name (uint8_t code)    { return name_of(NAMES, code); }
 }
 
 namespace DeliveryType
 {
-  const std::string SEND    = "Send Delivery";
-  const std::string RECEIVE = "Receive Delivery";
+  enum : uint8_t { NONE, SEND, RECEIVE };
+  constexpr std::string_view NAMES[] = { "", "Send Delivery", "Receive Delivery" };
+
+  inline uint8_t parse (std::string_view value)  { return code_of(NAMES, value, "must send or receive."); }
+  inline std::string_view name (uint8_t code)    { return name_of(NAMES, code); }
 }
 namespace DeliveryActivity
 {
-  const std::string SEND_DELIVERY    = "Send Delivery";
-  const std::string EDIT_CARGO       = "Edit Cargo";
-  const std::string RECEIVE_DELIVERY = "Receive Delivery";
-  const std::string CANCEL_DELIVERY  = "Cancel Delivery";
+  enum : uint8_t { SEND_DELIVERY = 1, EDIT_CARGO, RECEIVE_DELIVERY, CANCEL_DELIVERY };
+}
+
+namespace JobType
+{
+  enum : uint8_t { NONE, RECEIVE_DELIVERY, CANCEL_DELIVERY, CANCEL_PROCESS, CLEAR_TABLE, CLEAR_ALL, PURGE_COMPANY, DELETE_DELIVERY };
+}
+// A job FAILED on a step its action could not take (say, an item that was deleted meanwhile)
+namespace JobStatus
+{
+  enum : uint8_t { NONE, PENDING, DONE, FAILED };
+}
+// Steps of clearing and purge jobs, each covering a table (or a few that belong together)
+namespace ClearStage
+{
+  enum : uint8_t { LOGS, ROLLUPS, COMPANIES, ITEMS, BALANCES, IN_TRANSIT, MACHINES, PRODUCTS, RECIPES, SITES, USERS,
+                   DELIVERIES, DELIVERY_LINES, PROCESSES, SYMBOLS, COUNTERS, JOBS };
 }
 
 
 namespace Actions
 {
-  const std::string NEW_DELIVERY    = "newdelivery";
-  const std::string EDIT_DELIVERY   = "editdelivery";
-  const std::string DELETE_DELIVERY = "deldelivery";
-  const std::string NEW_ITEM        = "newitem";
-  const std::string EDIT_ITEM       = "edititem";
-  const std::string DELETE_ITEM     = "delitem";
-  const std::string NEW_PROCESS     = "newprocess";
-  const std::string EDIT_PROCESS    = "editprocess";
-  const std::string DELETE_PROCESS  = "delprocess";
-}
\ No newline at end of file
+  constexpr const char* NEW_DELIVERY    = "newdelivery";
+  constexpr const char* EDIT_DELIVERY   = "editdelivery";
+  constexpr const char* DELETE_DELIVERY = "deldelivery";
+  constexpr const char* NEW_ITEM        = "newitem";
+  constexpr const char* EDIT_ITEM       = "edititem";
+  constexpr const char* DELETE_ITEM     = "delitem";
+  constexpr const char* NEW_PROCESS     = "newprocess";
+  constexpr const char* EDIT_PROCESS    = "editprocess";
+  constexpr const char* DELETE_PROCESS  = "delprocess";
+}
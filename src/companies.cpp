@@ -35,12 +35,12 @@ void tracelytics::newcompany (
 
     // Access table and make sure company doesnt exist
     auto companies_byid = _companies.get_index<eosio::name("byid")>();
-    auto company_itr = companies_byid.find(Checksum::COMPANY(companyId));
+    auto company_itr = Key::find_by_key(companies_byid, Key::COMPANY(companyId), [&](const auto& row) { return row.companyId == companyId; });
     check(company_itr == companies_byid.end(), "company already exists");
 
     // Create new company
     _companies.emplace(get_self(), [&](auto& d) {
-        d.index      = _companies.available_primary_key();
+        d.index      = next_index(_companies);
         d.createdBy  = user;
         d.updatedBy  = user;
         d.createdAt  = timestamp;
@@ -99,7 +99,7 @@ void tracelytics::editcompany (
 
     // Access table and make sure company exists
     auto companies_byid = _companies.get_index<eosio::name("byid")>();
-    auto company_itr = companies_byid.find(Checksum::COMPANY(companyId));
+    auto company_itr = Key::find_by_key(companies_byid, Key::COMPANY(companyId), [&](const auto& row) { return row.companyId == companyId; });
     check(company_itr != companies_byid.end(), "company does not exist.");
     check(companyId == company_itr->companyId, "company mismatch");
 
@@ -143,7 +143,7 @@ void tracelytics::delcompany (
 
     // Access table and make sure company exists
     auto companies_byid = _companies.get_index<eosio::name("byid")>();
-    auto company_itr = companies_byid.find(Checksum::COMPANY(companyId));
+    auto company_itr = Key::find_by_key(companies_byid, Key::COMPANY(companyId), [&](const auto& row) { return row.companyId == companyId; });
     check(company_itr != companies_byid.end(), "company does not exist.");
     check(companyId == company_itr->companyId, "company mismatch");
 
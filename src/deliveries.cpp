@@ -14,7 +14,7 @@ void tracelytics::newdelivery (
     const std::string& toCompany,
     const time_point& startTime,
     const std::string& type,
-    std::map<std::string, ProductQuantity>& cargo,
+    CargoLines& cargo,
     const time_point& timestamp,
     const std::map<std::string, std::string>& data,
 
@@ -38,16 +38,20 @@ void tracelytics::newdelivery (
     check(!fromCompany.empty(), "sending company is missing.");
     check(!toCompany.empty(),   "receiving company is missing.");
     check(company == fromCompany || company == toCompany, "must be part of sending or receiving company."); // IMPORTANT
-    check(type == DeliveryActivity::SEND_DELIVERY || type == DeliveryActivity::RECEIVE_DELIVERY, "must send or receive."); // IMPORTANT
+    auto deliveryType = DeliveryType::parse(type);
+    check(deliveryType != DeliveryType::NONE, "must send or receive."); // IMPORTANT
+    const uint8_t newStatus = status ? DeliveryStatus::parse(*status) : DeliveryStatus::NONE;
+    if (status) check(newStatus != DeliveryStatus::RECEIVING && newStatus != DeliveryStatus::CANCELLING, "status " + *status + " is set by the delivery's job");
+    Cargo::normalize(cargo);
 
     // Access table and make sure delivery doesnt exist
     auto deliveries_byid = _deliveries.get_index<eosio::name("byroute")>();
-    auto delivery = deliveries_byid.find(Checksum::DELIVERY(deliveryId, route));
+    auto delivery = Key::find_by_key(deliveries_byid, Key::DELIVERY(deliveryId, route), [&](const auto& row) { return row.deliveryId == deliveryId && row.route == route; });
     check(delivery == deliveries_byid.end(), "delivery already exists");
 
     // Create new delivery
     _deliveries.emplace(get_self(), [&](auto& d) {
-        d.index     = _deliveries.available_primary_key();
+        d.index     = next_index(_deliveries);
         d.createdBy = user;
         d.updatedBy = user;
         d.createdAt = timestamp;
@@ -60,14 +64,13 @@ void tracelytics::newdelivery (
         d.fromCompany = fromCompany;
         d.toCompany   = toCompany;
         d.startTime   = startTime;
-        d.type        = type;
-        d.cargo       = cargo;
+        d.type        = deliveryType;
 
         // Optional
         if (endTime)     d.endTime     = *endTime;
         if (shipper)     d.shipper     = *shipper;
         if (driver)      d.driver      = *driver;
-        if (status)      d.status      = *status;
+        if (status)      d.set_status(*status);
         if (description) d.description = *description;
         if (version)     d.version     = *version;
 
@@ -76,25 +79,29 @@ void tracelytics::newdelivery (
         auto site = check_site_exists(toCompany, toSite);
 
         // Scenario 1: Magical receive delivery (credit only)
-        if (type == DeliveryActivity::RECEIVE_DELIVERY) {
-            d.status = DeliveryStatus::DELIVERED;
+        if (deliveryType == DeliveryType::RECEIVE) {
+            d.set_status(DeliveryStatus::DELIVERED);
             if (!endTime) d.endTime = timestamp;
 
-            std::map<std::string, std::string> call_data;
-            for( auto const& [item, productAndQuantity] : d.cargo ) {
-                tracelytics::newitem_action newitem_action( get_self(), {get_self(), eosio::name("active")} );
-                newitem_action.send( d.updatedBy,
-                                     d.toCompany,
-                                     d.toSite,
-                                     item,
-                                     productAndQuantity.product,
-                                     productAndQuantity.quantity,
-                                     productAndQuantity.metadata,
-                                     Actions::NEW_DELIVERY,
-                                     d.deliveryId,
-                                     d.updatedAt,
-                                     call_data,
-                                     std::nullopt);
+            auto items_byid = _items.get_index<eosio::name("byid")>();
+            for( auto const& [item, productAndQuantity] : cargo ) {
+                check(!item.empty(),                       "item ID is missing.");
+                check(!productAndQuantity.product.empty(), "product is missing.");
+                check(productAndQuantity.quantity > 0,     "quantity must be positive to create item.");
+                auto existing_item = Key::find_by_key(items_byid, Key::ITEM(item), [&](const auto& row) { return row.itemId == item; });
+                check(existing_item == items_byid.end(), "Error creating item " + item + " as it already exists");
+
+                create_item(d.updatedBy,
+                            d.toCompany,
+                            d.toSite,
+                            item,
+                            productAndQuantity.product,
+                            productAndQuantity.quantity,
+                            productAndQuantity.metadata,
+                            Actions::NEW_DELIVERY,
+                            d.deliveryId,
+                            d.updatedAt);
+                set_cargo_line(d.index, item, productAndQuantity);
             }
             return;
         }
@@ -102,21 +109,24 @@ void tracelytics::newdelivery (
         // Scenario 2: Sending delivery to not tracked site (charge and credit immediately)
         if (!site.tracked) {
             // Process sending
-            processDelivery(d, d.cargo, DeliveryActivity::SEND_DELIVERY, Actions::NEW_DELIVERY);
+            processDelivery(d, cargo, DeliveryActivity::SEND_DELIVERY, Actions::NEW_DELIVERY);
             // Change status
-            d.status = DeliveryStatus::DELIVERED;
+            d.set_status(DeliveryStatus::DELIVERED);
             if (!endTime) d.endTime = timestamp;
             // Process receiving
-            processDelivery(d, d.cargo, DeliveryActivity::RECEIVE_DELIVERY, Actions::NEW_DELIVERY);
+            processDelivery(d, cargo, DeliveryActivity::RECEIVE_DELIVERY, Actions::NEW_DELIVERY);
             return;
         }
 
         // Scenario 3: Normal sending delivery (charge only)
         if (site.tracked) {
-            processDelivery(d, d.cargo, DeliveryActivity::SEND_DELIVERY, Actions::NEW_DELIVERY);
+            processDelivery(d, cargo, DeliveryActivity::SEND_DELIVERY, Actions::NEW_DELIVERY);
             return;
         }
     });
+
+    // Write the moved items (once each, also when sent and received at once)
+    commit_items();
 }
 
 /**
@@ -127,7 +137,7 @@ void tracelytics::editdelivery (
     const std::string& company,
     const std::string& deliveryId,
     const std::string& route,
-    std::map<std::string, ProductQuantity>& cargoDeltas,
+    CargoLines& cargoDeltas,
     const time_point& timestamp,
     const std::map<std::string, std::string>& data,
 
@@ -149,49 +159,66 @@ void tracelytics::editdelivery (
     check(!company.empty(),    "company is missing.");
     check(!deliveryId.empty(), "delivery ID is missing.");
     // check(!route.empty(),      "route is missing."); // Can be empty
+    Cargo::normalize(cargoDeltas);
 
     // Access table and make sure delivery exists
     auto deliveries_byid = _deliveries.get_index<eosio::name("byroute")>();
-    auto delivery = deliveries_byid.find(Checksum::DELIVERY(deliveryId, route));
+    auto delivery = Key::find_by_key(deliveries_byid, Key::DELIVERY(deliveryId, route), [&](const auto& row) { return row.deliveryId == deliveryId && row.route == route; });
     check(delivery != deliveries_byid.end(), "delivery does not exist.");
     check(deliveryId == delivery->deliveryId && route == delivery->route, "delivery mismatch");
 
     if (user != ADMIN) {
         check(company == delivery->fromCompany || company == delivery->toCompany, "user must be part of sending or receiving company."); // IMPORTANT
-        check(delivery->status != DeliveryStatus::DELIVERED, "cannot edit a delivered delivery");
-        check(delivery->status != DeliveryStatus::CANCELLED, "cannot edit a cancelled delivery");
+        check(delivery->status != DeliveryStatus::DELIVERED,  "cannot edit a delivered delivery");
+        check(delivery->status != DeliveryStatus::CANCELLED,  "cannot edit a cancelled delivery");
+        check(delivery->status != DeliveryStatus::RECEIVING,  "cannot edit a delivery while it is received");
+        check(delivery->status != DeliveryStatus::CANCELLING, "cannot edit a delivery while it is cancelled");
     }
+    check(delivery->status != DeliveryStatus::CANCELLING || !status, "cannot change the status of a delivery while it is cancelled");
 
-    // Edit delivery
-    deliveries_byid.modify(delivery, get_self(), [&](auto& d) {
-        d.updatedBy = user;
-        d.updatedAt = timestamp;
+    // Edit delivery (a copy, written back only if it changes: cargo edits otherwise touch only their lines)
+    Delivery d = *delivery;
+    d.updatedBy = user;
+    d.updatedAt = timestamp;
 
-        // Checks: 1) New status is DELIVERED and old status is not DELIVERED
-        bool justDelivered = status.value_or("") == DeliveryStatus::DELIVERED && d.status != DeliveryStatus::DELIVERED;
+    // Checks: 1) New status is DELIVERED and old status is not DELIVERED (RECEIVING retries the job)
+    const uint8_t newStatus = status ? DeliveryStatus::parse(*status) : DeliveryStatus::NONE;
+    if (status) check(newStatus != DeliveryStatus::RECEIVING && newStatus != DeliveryStatus::CANCELLING, "status " + *status + " is set by the delivery's job");
+    bool justDelivered = newStatus == DeliveryStatus::DELIVERED && d.status != DeliveryStatus::DELIVERED;
+    bool editsHeader = shipper || driver || startTime || endTime || status || toSite || toCompany || description || version;
 
-        // Optional
-        if (shipper)     d.shipper     = *shipper;
-        if (driver)      d.driver      = *driver;
-        if (startTime)   d.startTime   = *startTime;
-        if (endTime)     d.endTime     = *endTime;
-        if (status)      d.status      = *status;
-        if (toSite)      d.toSite      = *toSite;
-        if (toCompany)   d.toCompany   = *toCompany;
-        if (description) d.description = *description;
-        if (version)     d.version     = *version;
+    // Optional
+    if (shipper)     d.shipper     = *shipper;
+    if (driver)      d.driver      = *driver;
+    if (startTime)   d.startTime   = *startTime;
+    if (endTime)     d.endTime     = *endTime;
+    if (status)      d.set_status(*status);
+    if (toSite)      d.toSite      = *toSite;
+    if (toCompany)   d.toCompany   = *toCompany;
+    if (description) d.description = *description;
+    if (version)     d.version     = *version;
 
-        // Process add/remove
-        // TODO Check if we want to allow editing and delivering in same call
-        if (cargoDeltas.size() > 0) {
-            processDelivery(d, cargoDeltas, DeliveryActivity::EDIT_CARGO, Actions::EDIT_DELIVERY);
-        }
+    // Received by a job: DELIVERED once it has moved the cargo
+    if (justDelivered) d.set_status(DeliveryStatus::RECEIVING);
 
-        // Process delivery
-        if (justDelivered) {
-            processDelivery(d, d.cargo, DeliveryActivity::RECEIVE_DELIVERY, Actions::EDIT_DELIVERY);
-        }
-    });
+    // Process add/remove
+    // TODO Check if we want to allow editing and delivering in same call
+    if (cargoDeltas.size() > 0) {
+        processDelivery(d, cargoDeltas, DeliveryActivity::EDIT_CARGO, Actions::EDIT_DELIVERY);
+    }
+
+    // Cargo edits still record who edited the delivery and when
+    if (editsHeader || cargoDeltas.size() > 0) {
+        deliveries_byid.modify(delivery, get_self(), [&](auto& row) { row = d; });
+    }
+
+    // Write the moved items
+    commit_items();
+
+    // Process delivery (as a job, the cargo may not fit this transaction)
+    if (justDelivered) {
+        start_job(JobType::RECEIVE_DELIVERY, d.index, timestamp);
+    }
 }
 
 /**
@@ -216,27 +243,80 @@ void tracelytics::deldelivery (
 
     // Access table and make sure delivery exists
     auto deliveries_byid = _deliveries.get_index<eosio::name("byroute")>();
-    auto delivery = deliveries_byid.find(Checksum::DELIVERY(deliveryId, route));
+    auto delivery = Key::find_by_key(deliveries_byid, Key::DELIVERY(deliveryId, route), [&](const auto& row) { return row.deliveryId == deliveryId && row.route == route; });
     check(delivery != deliveries_byid.end(), "delivery does not exist.");
     check(deliveryId == delivery->deliveryId && route == delivery->route, "delivery mismatch");
 
     if (user != ADMIN) {
         check(company == delivery->fromCompany, "the user must be a part of the sending company.");
-        check(delivery->status != DeliveryStatus::DELIVERED, "cannot cancel or delete a delivered delivery");
-        check(delivery->status != DeliveryStatus::CANCELLED, "cannot cancel or delete a cancelled delivery");
+        check(delivery->status != DeliveryStatus::DELIVERED,  "cannot cancel or delete a delivered delivery");
+        check(delivery->status != DeliveryStatus::CANCELLED,  "cannot cancel or delete a cancelled delivery");
+        check(delivery->status != DeliveryStatus::CANCELLING, "cannot cancel or delete a delivery while it is cancelled");
         check(cancel, "only admins can delete a delivery.");
     }
+    check(delivery->status != DeliveryStatus::RECEIVING || !cancel, "cannot cancel a delivery while it is received");
 
     if (cancel) {
         deliveries_byid.modify(delivery, get_self(), [&](auto& d) {
             d.updatedBy = user;
             d.updatedAt = timestamp;
-            d.status = DeliveryStatus::CANCELLED;
-
-            // Refund
-            processDelivery(d, d.cargo, DeliveryActivity::CANCEL_DELIVERY, Actions::DELETE_DELIVERY);
+            d.set_status(DeliveryStatus::CANCELLING); // CANCELLED once the job has moved the cargo back
         });
+
+        // Refund (as a job, the cargo may not fit this transaction)
+        start_job(JobType::CANCEL_DELIVERY, delivery->index, timestamp);
     } else {
+        // The lines go as a job, there may be more than fit this transaction
+        const uint64_t index = delivery->index;
         deliveries_byid.erase(delivery);
+        start_job(JobType::DELETE_DELIVERY, index, timestamp);
+    }
+}
+
+/**
+ * Cargo lines
+ **/
+// Adds the line of `item`, or replaces it
+void tracelytics::set_cargo_line (uint64_t delivery, const std::string& item, const ProductQuantity& productAndQuantity) {
+    auto lines = _delivery_lines.get_index<eosio::name("bydelivitem")>();
+    auto key = ((uint128_t) delivery << 64) | Key::hash64(item);
+    auto line = lines.find(key);
+    while (line != lines.end() && line->by_delivery_and_item() == key && line->itemId != item) ++line;
+
+    auto write = [&](auto& l) {
+        l.delivery = delivery;
+        l.itemId   = item;
+        l.product  = productAndQuantity.product;
+        l.quantity = productAndQuantity.quantity;
+        l.metadata = productAndQuantity.metadata;
+    };
+    if (line != lines.end() && line->by_delivery_and_item() == key) {
+        lines.modify(line, get_self(), write);
+    } else {
+        _delivery_lines.emplace(get_self(), [&](auto& l) {
+            l.index = next_index(_delivery_lines);
+            write(l);
+        });
+    }
+}
+
+void tracelytics::erase_cargo_line (uint64_t delivery, const std::string& item) {
+    auto lines = _delivery_lines.get_index<eosio::name("bydelivitem")>();
+    auto key = ((uint128_t) delivery << 64) | Key::hash64(item);
+    for (auto line = lines.find(key); line != lines.end() && line->by_delivery_and_item() == key; ++line) {
+        if (line->itemId == item) {
+            lines.erase(line);
+            return;
+        }
+    }
+}
+
+// Erases up to max_lines lines of a delivery, returns how many (fewer than max_lines once none are left)
+uint32_t tracelytics::erase_cargo (uint64_t delivery, uint32_t max_lines) {
+    auto lines = _delivery_lines.get_index<eosio::name("bydelivitem")>();
+    uint32_t erased = 0;
+    for (auto line = lines.lower_bound((uint128_t) delivery << 64); line != lines.end() && line->delivery == delivery && erased < max_lines; ++erased) {
+        line = lines.erase(line);
     }
+    return erased;
 }
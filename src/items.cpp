@@ -35,45 +35,11 @@ void tracelytics::newitem (
 
     // Access table and make sure item doesnt exist
     auto items_byid = _items.get_index<eosio::name("byid")>();
-    auto item = items_byid.find(Checksum::ITEM(itemId));
+    auto item = Key::find_by_key(items_byid, Key::ITEM(itemId), [&](const auto& row) { return row.itemId == itemId; });
     check(item == items_byid.end(), "Error creating item " + itemId + " as it already exists at site " + item->site);
 
     // Create new item
-    auto new_item = _items.emplace(get_self(), [&](auto& p) {
-        p.index     = _items.available_primary_key();
-        p.createdBy = user;
-        p.updatedBy = user;
-        p.createdAt = timestamp;
-        p.updatedAt = timestamp;
-
-        p.company   = company;
-        p.site      = site;
-        p.itemId    = itemId;
-        p.quantity  = quantity;
-        p.product   = product;
-
-        // Optional
-        if (metadata.count("parent"))      p.metadata["parent"]      = metadata["parent"];
-        if (metadata.count("description")) p.metadata["description"] = metadata["description"];
-        if (metadata.count("image"))       p.metadata["image"]       = metadata["image"];
-    });
-
-    // Log the new quantity
-    tracelytics::loginventory_action loginventory_action( get_self(), {get_self(), "active"_n} );
-    loginventory_action.send(new_item->createdBy,
-                             new_item->company,
-                             new_item->itemId,
-                             new_item->site,
-                             new_item->product,
-                             new_item->delivery,
-                             new_item->metadata,
-                             (std::string) "newitem",
-                             action,
-                             actionId,
-                             new_item->createdAt,
-                             new_item->version,
-                             0.0,
-                             new_item->quantity);
+    create_item(user, company, site, itemId, product, quantity, metadata, action, actionId, timestamp);
 }
 
 /**
@@ -107,7 +73,7 @@ void tracelytics::edititem (
 
     // Access table and make sure item exists
     auto items_byid = _items.get_index<eosio::name("byid")>();
-    auto item = items_byid.find(Checksum::ITEM(itemId));
+    auto item = Key::find_by_key(items_byid, Key::ITEM(itemId), [&](const auto& row) { return row.itemId == itemId; });
     check(item != items_byid.end(), "Error editing item " + itemId + " as it does not exist at site " + site);
     check(itemId == item->itemId, "item mismatch");
 
@@ -116,57 +82,12 @@ void tracelytics::edititem (
         check(company == item->company, "only employees of " + item->company + " can edit item " + itemId + ". Current user is from" + company + ".");
     }
 
-    // Edit item
-    items_byid.modify(item, get_self(), [&](auto& p) {
-        p.updatedBy = user;
-        p.updatedAt = timestamp;
-
-        // Optional
-        if (product)  p.product  = *product;
-        if (delivery) p.delivery = *delivery;
-        if (version)  p.version  = *version;
-        if (metadata.count("parent"))      p.metadata["parent"]      = metadata["parent"];
-        if (metadata.count("description")) p.metadata["description"] = metadata["description"];
-
-        // Update quantity and log it
-        // MAKE SURE this is at the end of the modify function, so it uses updated product/site values
-        if (quantity || delta) {
-            auto oldQuantity = p.quantity;
-
-            // If quantity, set quantity to equal new quantity
-            // If delta, change quantity by delta quantity
-            if (quantity) {
-                p.quantity = *quantity;
-            } else if (delta) {
-                p.quantity += *delta;
-            }
-
-            // Validation (must be 0 or positive)
-            check(p.quantity >= 0, "Item " + p.itemId + " quantity at site " + p.site + " must be zero or positive. Provided quantity: " + to_string(p.quantity));
-
-            // Log quantity change
-            tracelytics::loginventory_action loginventory_action( get_self(), {get_self(), "active"_n} );
-            loginventory_action.send(p.updatedBy,
-                                     p.company,
-                                     p.itemId,
-                                     p.site,
-                                     p.product,
-                                     p.delivery,
-                                     p.metadata,
-                                     (std::string) "edititem",
-                                     action,
-                                     actionId,
-                                     p.updatedAt,
-                                     p.version,
-                                     oldQuantity,
-                                     p.quantity);
-        }
-    });
+    // If quantity, set quantity to equal new quantity
+    // If delta, change quantity by delta quantity
+    double newQuantity = quantity ? *quantity : item->quantity + *delta;
 
-    // Delete if quantity is 0
-    if (item->quantity == 0) {
-        items_byid.erase(item);
-    }
+    // Edit item
+    update_item(*item, user, newQuantity, metadata, action, actionId, timestamp, product, delivery, version);
 }
 
 /**
@@ -192,7 +113,7 @@ void tracelytics::delitem (
 
     // Access table and make sure item exists
     auto items_byid = _items.get_index<eosio::name("byid")>();
-    auto item = items_byid.find(Checksum::ITEM(itemId));
+    auto item = Key::find_by_key(items_byid, Key::ITEM(itemId), [&](const auto& row) { return row.itemId == itemId; });
     check(item != items_byid.end(), "Error deleting item " + itemId + " as it does not exist at site " + site);
     check(site == item->site && itemId == item->itemId, "item mismatch");
 
@@ -201,22 +122,299 @@ void tracelytics::delitem (
     }
 
     // Log quantity change
-    tracelytics::loginventory_action loginventory_action( get_self(), {get_self(), "active"_n} );
-    loginventory_action.send(item->updatedBy,
-                             item->company,
-                             item->itemId,
-                             item->site,
-                             item->product,
-                             item->delivery,
-                             item->metadata,
-                             (std::string) "delitem",
-                             action,
-                             actionId,
-                             timestamp,
-                             item->version,
-                             item->quantity,
-                             0.0);
+    log_inventory(item->updatedBy,
+                  item->company,
+                  item->itemId,
+                  item->site,
+                  item->product,
+                  item->delivery,
+                  (std::string) "delitem",
+                  action,
+                  actionId,
+                  timestamp,
+                  item->quantity,
+                  0.0);
 
     // Delete item
+    track_balance(*item, -1);
     items_byid.erase(item);
-}
\ No newline at end of file
+}
+
+/**
+ * Create an item and log its quantity
+ * Callers validate the arguments and make sure the item does not exist yet.
+ **/
+const tracelytics::Item& tracelytics::create_item (
+    const std::string& user,
+    const std::string& company,
+    const std::string& site,
+    const std::string& itemId,
+    const std::string& product,
+    const double& quantity,
+    const std::map<std::string, std::string>& metadata,
+    const std::string& action,
+    const std::string& actionId,
+    const time_point& timestamp
+) {
+    auto new_item = _items.emplace(get_self(), [&](auto& p) {
+        p.index     = next_index(_items);
+        p.createdBy = user;
+        p.updatedBy = user;
+        p.createdAt = timestamp;
+        p.updatedAt = timestamp;
+
+        p.company   = company;
+        p.site      = site;
+        p.itemId    = itemId;
+        p.quantity  = quantity;
+        p.product   = product;
+
+        // Optional
+        if (metadata.count("parent"))      p.metadata["parent"]      = metadata.at("parent");
+        if (metadata.count("description")) p.metadata["description"] = metadata.at("description");
+        if (metadata.count("image"))       p.metadata["image"]       = metadata.at("image");
+    });
+
+    track_balance(*new_item, +1);
+
+    // Log the new quantity
+    log_inventory(new_item->createdBy,
+                  new_item->company,
+                  new_item->itemId,
+                  new_item->site,
+                  new_item->product,
+                  new_item->delivery,
+                  (std::string) "newitem",
+                  action,
+                  actionId,
+                  new_item->createdAt,
+                  0.0,
+                  new_item->quantity);
+
+    return *new_item;
+}
+
+/**
+ * Set the quantity of an existing item and log the change; the item is deleted once it reaches 0
+ * Callers look the item up and check the user may edit it.
+ **/
+void tracelytics::update_item (
+    const Item& item,
+    const std::string& user,
+    const double& quantity,
+    const std::map<std::string, std::string>& metadata,
+    const std::string& action,
+    const std::string& actionId,
+    const time_point& timestamp,
+    const optional<std::string_view>& product,
+    const optional<std::string_view>& delivery,
+    const optional<std::string_view>& version
+) {
+    // Validation (must be 0 or positive)
+    check(quantity >= 0, "Item " + item.itemId + " quantity at site " + item.site + " must be zero or positive. Provided quantity: " + to_string(quantity));
+
+    const double oldQuantity = item.quantity;
+    track_balance(item, -1);
+    _items.modify(item, get_self(), [&](auto& p) {
+        p.updatedBy = user;
+        p.updatedAt = timestamp;
+
+        // Optional
+        if (product)  p.product  = *product;
+        if (delivery) p.delivery = *delivery;
+        if (version)  p.version  = *version;
+        if (metadata.count("parent"))      p.metadata["parent"]      = metadata.at("parent");
+        if (metadata.count("description")) p.metadata["description"] = metadata.at("description");
+
+        p.quantity = quantity;
+    });
+    track_balance(item, +1);
+
+    // Log quantity change, with the updated product
+    log_inventory(item.updatedBy,
+                  item.company,
+                  item.itemId,
+                  item.site,
+                  item.product,
+                  item.delivery,
+                  (std::string) "edititem",
+                  action,
+                  actionId,
+                  item.updatedAt,
+                  oldQuantity,
+                  item.quantity);
+
+    // Delete if quantity is 0
+    if (item.quantity == 0) {
+        _items.erase(item);
+    }
+}
+
+/**
+ * Item `itemId` as changed so far by this action, loaded on first use
+ **/
+tracelytics::Item& tracelytics::pending_item (const std::string& itemId) {
+    auto pending = _pending_items.find(itemId);
+    if (pending != _pending_items.end()) return pending->second;
+
+    const Item* item = find_item(itemId);
+    check(item != nullptr, "item " + itemId + " does not exist");
+
+    return _pending_items.emplace(itemId, *item).first->second;
+}
+
+/**
+ * Item `itemId` as changed so far by this action, or nullptr if it does not exist
+ **/
+const tracelytics::Item* tracelytics::find_item (const std::string& itemId) {
+    auto pending = _pending_items.find(itemId);
+    if (pending != _pending_items.end()) return &pending->second;
+
+    auto items_byid = _items.get_index<eosio::name("byid")>();
+    auto item = Key::find_by_key(items_byid, Key::ITEM(itemId), [&](const auto& row) { return row.itemId == itemId; });
+    return item != items_byid.end() ? &*item : nullptr;
+}
+
+/**
+ * Write the items changed through pending_item, one modify per row
+ **/
+void tracelytics::commit_items () {
+    for (const auto& [itemId, pending] : _pending_items) {
+        const auto& item = _items.get(pending.index);
+        track_balance(item, -1);
+        track_balance(pending, +1);
+        _items.modify(item, same_payer, [&](auto& i) {
+            i = pending;
+        });
+    }
+    _pending_items.clear();
+}
+
+/**
+ * Split `quantity` off an item changed through pending_item into a new item named `childId`,
+ * or `childId.2`, `childId.3`, ... when that is taken (the same item split again for one delivery).
+ * The child is created at the item's site, records the item as its "parent" in metadata, and is
+ * returned as a pending item too.
+ **/
+tracelytics::Item& tracelytics::split_item (
+    Item& parent,
+    const std::string& baseId,
+    const double& quantity,
+    const std::string& user,
+    const std::string& action,
+    const std::string& actionId,
+    const time_point& timestamp
+) {
+    auto items_byid = _items.get_index<eosio::name("byid")>();
+    auto taken = [&](const std::string& id) {
+        if (_pending_items.count(id)) return true;
+        auto existing = Key::find_by_key(items_byid, Key::ITEM(id), [&](const auto& row) { return row.itemId == id; });
+        return existing != items_byid.end();
+    };
+    std::string childId = baseId;
+    for (uint32_t n = 2; taken(childId); ++n) {
+        childId = baseId + "." + to_string(n);
+    }
+
+    // The parent keeps the rest
+    const double oldQuantity = parent.quantity;
+    parent.quantity -= quantity;
+    parent.updatedBy = user;
+    parent.updatedAt = timestamp;
+    log_inventory(parent.updatedBy,
+                  parent.company,
+                  parent.itemId,
+                  parent.site,
+                  parent.product,
+                  parent.delivery,
+                  (std::string) "edititem",
+                  action,
+                  actionId,
+                  timestamp,
+                  oldQuantity,
+                  parent.quantity);
+
+    auto metadata = parent.metadata;
+    metadata["parent"] = parent.itemId;
+    const auto& child = create_item(user, parent.company, parent.site, childId, parent.product, quantity, metadata, action, actionId, timestamp);
+    return _pending_items.emplace(childId, child).first->second;
+}
+
+/**
+ * Add (sign +1) or remove (sign -1) an item's quantity to the balance it counts towards:
+ * its site's balance, or the in-transit balance of its company pair while on a delivery
+ **/
+void tracelytics::track_balance (const Item& item, double sign) {
+    if (item.quantity == 0) return;
+
+    if (item.delivery.empty()) {
+        _balance_deltas[{ item.company, item.site, item.product }] += sign * item.quantity;
+    } else {
+        _in_transit_deltas[{ item.company, item.product }] += sign * item.quantity;
+    }
+}
+
+/**
+ * Whether a sum of quantities is zero up to rounding: deltas are sums of item quantities with
+ * both signs, so a balance that is emptied out may be left at 1e-17 rather than 0.
+ * The tolerance is relative to the quantities summed, and absolute below 1.
+ **/
+static bool near_zero (double value, double scale = 1) {
+    return std::abs(value) <= 1e-9 * std::max(1.0, std::abs(scale));
+}
+
+/**
+ * Write the balance changes of this action, once per balance row. Rows that reach zero are erased.
+ **/
+void tracelytics::save_balances () {
+    auto balances_bysiteprod = _balances.get_index<eosio::name("bysiteprod")>();
+    for (const auto& [key, delta] : _balance_deltas) {
+        if (near_zero(delta)) continue;
+        const auto& [company, site, product] = key;
+
+        auto balance = Key::find_by_key(balances_bysiteprod, Key::hash(company, site, product), [&](const auto& row) {
+            return row.company == company && row.site == site && row.product == product;
+        });
+        if (balance == balances_bysiteprod.end()) {
+            _balances.emplace(get_self(), [&](auto& b) {
+                b.index    = next_index(_balances);
+                b.company  = company;
+                b.site     = site;
+                b.product  = product;
+                b.quantity = delta;
+            });
+        } else if (near_zero(balance->quantity + delta, balance->quantity)) {
+            balances_bysiteprod.erase(balance);
+        } else {
+            balances_bysiteprod.modify(balance, get_self(), [&](auto& b) {
+                b.quantity += delta;
+            });
+        }
+    }
+    _balance_deltas.clear();
+
+    auto in_transit_byproduct = _in_transit.get_index<eosio::name("byproduct")>();
+    for (const auto& [key, delta] : _in_transit_deltas) {
+        if (near_zero(delta)) continue;
+        const auto& [company, product] = key;
+
+        auto in_transit = Key::find_by_key(in_transit_byproduct, Key::hash(company, product), [&](const auto& row) {
+            return row.company == company && row.product == product;
+        });
+        if (in_transit == in_transit_byproduct.end()) {
+            _in_transit.emplace(get_self(), [&](auto& t) {
+                t.index    = next_index(_in_transit);
+                t.company  = company;
+                t.product  = product;
+                t.quantity = delta;
+            });
+        } else if (near_zero(in_transit->quantity + delta, in_transit->quantity)) {
+            in_transit_byproduct.erase(in_transit);
+        } else {
+            in_transit_byproduct.modify(in_transit, get_self(), [&](auto& t) {
+                t.quantity += delta;
+            });
+        }
+    }
+    _in_transit_deltas.clear();
+}
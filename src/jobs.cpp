@@ -0,0 +1,249 @@
+#include "tracelytics/tracelytics.hpp"
+
+void tracelytics::crank (const uint32_t& max_steps, const optional<uint64_t>& job) {
+    check(max_steps > 0, "max_steps must be positive");
+
+    // One job, so a job that keeps failing does not hold up the others
+    if (job) {
+        auto row = _jobs.find(*job);
+        check(row != _jobs.end(), "job does not exist");
+        check(row->status == JobStatus::PENDING || row->status == JobStatus::FAILED, "job is done");
+
+        Job j = *row;
+        j.status = JobStatus::PENDING;
+        run_job(j, max_steps);
+        j.updatedAt = current_time_point();
+        _jobs.modify(row, get_self(), [&](auto& r) { r = j; });
+        return;
+    }
+
+    auto jobs_bystatus = _jobs.get_index<eosio::name("bystatus")>();
+    const uint128_t pending = (uint128_t) JobStatus::PENDING << 64;
+
+    uint32_t steps = 0;
+    for (auto job = jobs_bystatus.lower_bound(pending); job != jobs_bystatus.end() && job->status == JobStatus::PENDING && steps < max_steps; job = jobs_bystatus.lower_bound(pending)) {
+        Job j = *job;
+        steps += run_job(j, max_steps - steps);
+        j.updatedAt = current_time_point();
+        jobs_bystatus.modify(job, get_self(), [&](auto& row) { row = j; });
+    }
+}
+
+/**
+ * Run the first max_steps steps of a job, or the next ones if the same job (type and target)
+ * is already pending or has failed. The job is stored either way, for crank to resume and for
+ * clients to find by its target (bytarget).
+ **/
+void tracelytics::start_job (uint8_t type, uint64_t target, const time_point& timestamp, uint32_t max_steps) {
+    auto jobs_bytarget = _jobs.get_index<eosio::name("bytarget")>();
+    const uint128_t key = ((uint128_t) type << 64) | target;
+    for (auto pending = jobs_bytarget.lower_bound(key); pending != jobs_bytarget.end() && pending->by_target() == key; ++pending) {
+        if (pending->status != JobStatus::PENDING && pending->status != JobStatus::FAILED) continue;
+
+        Job job = *pending;
+        job.status = JobStatus::PENDING;
+        run_job(job, max_steps);
+        job.updatedAt = timestamp;
+        jobs_bytarget.modify(pending, get_self(), [&](auto& j) { j = job; });
+        return;
+    }
+
+    Job job;
+    job.index     = next_index(_jobs);
+    job.type      = type;
+    job.status    = JobStatus::PENDING;
+    job.stage     = 0;
+    job.target    = target;
+    job.scope     = 0;
+    job.cursor    = 0;
+    job.steps     = 0;
+    job.createdAt = timestamp;
+    job.updatedAt = timestamp;
+
+    run_job(job, max_steps);
+    _jobs.emplace(get_self(), [&](auto& j) { j = job; });
+}
+
+void tracelytics::prunejobs (const uint32_t& max_rows) {
+    require_auth( get_self() );
+    check(max_rows > 0, "max_rows must be positive");
+
+    auto jobs_bystatus = _jobs.get_index<eosio::name("bystatus")>();
+    const uint128_t done = (uint128_t) JobStatus::DONE << 64;
+    uint32_t rows = 0;
+    for (auto job = jobs_bystatus.lower_bound(done); job != jobs_bystatus.end() && job->status == JobStatus::DONE && rows < max_rows; ++rows) {
+        job = jobs_bystatus.erase(job);
+    }
+}
+
+/**
+ * Run up to max_steps steps of a job (one per cargo line, or per row cleared or examined) and
+ * advance its cursor, marking it DONE once nothing is left or its target is gone. Returns the
+ * steps taken.
+ *
+ * Cargo lines (delivery lines and process inputs) are walked in the order of their item's key,
+ * and the cursor holds the key of the next one, so edits to the rest of the cargo do not move it.
+ * Lines sharing a key are never split across calls, so a call may take a few extra steps.
+ * A line that cannot be moved (its item was deleted or changed meanwhile) stops the job as FAILED
+ * at that line, where it resumes once it is started again or cranked by index.
+ **/
+uint32_t tracelytics::run_job (Job& job, uint32_t max_steps) {
+    uint32_t steps = 0;
+
+    if (job.type == JobType::RECEIVE_DELIVERY || job.type == JobType::CANCEL_DELIVERY) {
+        auto delivery = _deliveries.find(job.target);
+        if (delivery == _deliveries.end()) {
+            job.status = JobStatus::DONE;
+            return steps;
+        }
+
+        CargoLines cargo;
+        size_t group = 0; // First line of the current key
+        bool failed = false;
+        auto lines = _delivery_lines.get_index<eosio::name("bydelivitem")>();
+        auto line = lines.lower_bound(((uint128_t) job.target << 64) | job.cursor);
+        for (; line != lines.end() && line->delivery == job.target; ++line, ++steps) {
+            const uint64_t key = (uint64_t) line->by_delivery_and_item();
+            if (steps >= max_steps && key != job.cursor) break;
+            if (key != job.cursor || cargo.empty()) group = cargo.size();
+            job.cursor = key;
+
+            ProductQuantity productAndQuantity { { line->product, line->quantity }, line->metadata };
+            if (!can_move(line->itemId, productAndQuantity)) {
+                // Resume at this key, with the lines before it that share it
+                cargo.resize(group);
+                failed = true;
+                break;
+            }
+            cargo.emplace_back(line->itemId, productAndQuantity);
+        }
+        bool done = !failed && (line == lines.end() || line->delivery != job.target);
+        if (!done && !failed) job.cursor = (uint64_t) line->by_delivery_and_item();
+
+        Cargo::normalize(cargo);
+        if (job.type == JobType::RECEIVE_DELIVERY) {
+            processDelivery(*delivery, cargo, DeliveryActivity::RECEIVE_DELIVERY, Actions::EDIT_DELIVERY);
+        } else {
+            processDelivery(*delivery, cargo, DeliveryActivity::CANCEL_DELIVERY, Actions::DELETE_DELIVERY);
+        }
+        commit_items();
+
+        if (failed) job.status = JobStatus::FAILED;
+        if (done) {
+            job.status = JobStatus::DONE;
+
+            // The delivery is received or cancelled once all of its cargo has moved
+            const bool receive = job.type == JobType::RECEIVE_DELIVERY;
+            if (delivery->status == (receive ? DeliveryStatus::RECEIVING : DeliveryStatus::CANCELLING)) {
+                _deliveries.modify(delivery, same_payer, [&](auto& d) {
+                    d.set_status(receive ? DeliveryStatus::DELIVERED : DeliveryStatus::CANCELLED);
+                });
+            }
+        }
+    } else if (job.type == JobType::CANCEL_PROCESS) {
+        auto process = _processes.find(job.target);
+        if (process == _processes.end()) {
+            job.status = JobStatus::DONE;
+            return steps;
+        }
+
+        // Refund the inputs not refunded yet, in the order of their item's key
+        std::vector<std::pair<uint64_t, const CargoLines::value_type*>> inputs;
+        for (const auto& input : process->inputs) {
+            const uint64_t key = Key::hash64(input.first);
+            if (key >= job.cursor) inputs.emplace_back(key, &input);
+        }
+        std::sort(inputs.begin(), inputs.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+        CargoLines cargo;
+        size_t group = 0;
+        bool failed = false;
+        auto input = inputs.begin();
+        for (; input != inputs.end(); ++input, ++steps) {
+            if (steps >= max_steps && input->first != job.cursor) break;
+            if (input->first != job.cursor || cargo.empty()) group = cargo.size();
+            job.cursor = input->first;
+
+            if (!can_refund(*process, input->second->first, input->second->second)) {
+                cargo.resize(group);
+                failed = true;
+                break;
+            }
+            cargo.push_back(*input->second);
+        }
+
+        Cargo::normalize(cargo);
+        CargoLines emptyDeltas;
+        processcargo(*process, cargo, emptyDeltas, process->updatedBy, process->company, Actions::EDIT_PROCESS, ProcessActivity::FINISH_PROCESS);
+
+        if (failed) {
+            job.status = JobStatus::FAILED;
+        } else if (input == inputs.end()) {
+            job.status = JobStatus::DONE;
+        } else {
+            job.cursor = input->first;
+        }
+    } else if (job.type == JobType::DELETE_DELIVERY) {
+        // Lines of a deleted delivery (target is its former index)
+        steps = erase_cargo(job.target, max_steps);
+        if (steps < max_steps) job.status = JobStatus::DONE;
+    } else if (job.type == JobType::CLEAR_TABLE || job.type == JobType::CLEAR_ALL || job.type == JobType::PURGE_COMPANY) {
+        std::string company;
+        if (job.type == JobType::PURGE_COMPANY) {
+            auto symbol = _symbols.find(job.target);
+            if (symbol == _symbols.end()) {
+                job.status = JobStatus::DONE;
+                return steps;
+            }
+            company = symbol->value;
+        }
+
+        // A stage is done once it takes fewer steps than it was given
+        const auto stages = clear_stages(job);
+        while (job.stage < stages.size() && steps < max_steps) {
+            uint32_t budget = max_steps - steps;
+            uint32_t taken  = job.type == JobType::PURGE_COMPANY
+                ? purge_stage(stages[job.stage], company, job, budget)
+                : clear_stage(stages[job.stage], job, budget);
+            steps += taken;
+            if (taken < budget) {
+                ++job.stage;
+                job.scope  = 0;
+                job.cursor = 0;
+            }
+        }
+        if (job.stage == stages.size()) job.status = JobStatus::DONE;
+    } else {
+        check(false, "unknown job type");
+    }
+
+    job.steps += steps;
+    return steps;
+}
+
+/**
+ * Whether receiving or cancelling can move this line: its item still exists, with the quantity sent
+ **/
+bool tracelytics::can_move (const std::string& item, const ProductQuantity& productAndQuantity) {
+    const Item* i = find_item(item);
+    return i != nullptr && i->quantity > 0 && i->quantity == productAndQuantity.quantity;
+}
+
+/**
+ * Whether cancelling a process can refund this input: to its item if that is still at the
+ * process site (and the process company's, unless an admin cancelled), or to a new item at the site
+ **/
+bool tracelytics::can_refund (const Process& process, const std::string& item, const ProductQuantity& productAndQuantity) {
+    if (productAndQuantity.quantity < 0 || item.empty()) return false;
+    if (productAndQuantity.quantity == 0) return true;
+
+    auto items_byid = _items.get_index<eosio::name("byid")>();
+    auto existing = Key::find_by_key(items_byid, Key::ITEM(item), [&](const auto& row) { return row.itemId == item; });
+    if (existing != items_byid.end()) {
+        return existing->site == process.site && (process.updatedBy == ADMIN || existing->company == process.company);
+    }
+
+    auto sites_byid = _sites.get_index<eosio::name("byid")>();
+    auto site = Key::find_by_key(sites_byid, Key::SITE(process.site), [&](const auto& row) { return row.siteId == process.site; });
+    return !productAndQuantity.product.empty() && site != sites_byid.end() && site->company == process.company;
+}
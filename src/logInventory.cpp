@@ -1,50 +1,388 @@
 #include "tracelytics/tracelytics.hpp"
 
-void tracelytics::loginventory (
+void tracelytics::log_inventory (
     const std::string& user,
     const std::string& company,
     const std::string& item,
     const std::string& site,
     const std::string& product,
     const std::string& delivery,
-    std::map<std::string, std::string> metadata,
     const std::string& action,
     const std::string& parentAction,
     const std::string& parentActionId,
     const time_point&  timestamp,
-    const std::string& version,
-    const double&     oldQuantity,
-    const double&     newQuantity
+    const double&      oldQuantity,
+    const double&      newQuantity
 ) {
-    // Authentication
-    require_auth( get_self() );
-
     // Log
-    inventory_log_table inventory_logs(get_self(), get_self().value);
-    inventory_logs.emplace(get_self(), [&](auto& i) {
-        i.index          = inventory_logs.available_primary_key();
-        i.user           = user;
-        i.company        = company;
-        i.item           = item;
-        i.site           = site;
-        i.product        = product;
-        i.delivery       = delivery;
-        i.action         = action;
-        i.parentAction   = parentAction;
-        i.parentActionId = parentActionId;
-        i.version        = version;
-        i.metadata       = metadata;
+    auto& logs = log_partition(timestamp);
+    const uint64_t index = next_index(logs);
+    logs.emplace(get_self(), [&](auto& i) {
+        i.index          = index;
+        i.user           = intern(user);
+        i.company        = intern(company);
+        i.item           = intern(item);
+        i.site           = intern(site);
+        i.product        = intern(product);
+        i.delivery       = intern(delivery);
+        i.action         = intern(action);
+        i.parentAction   = intern(parentAction);
+        i.parentActionId = intern(parentActionId);
         i.timestamp      = timestamp;
 
-        i.oldQuantity    = oldQuantity;
         i.newQuantity    = newQuantity;
         i.delta          = newQuantity - oldQuantity;
+        i.transaction    = transaction_index(logs.get_scope());
+    });
+
+#ifdef TRACELYTICS_LOG_NOTIFY
+    _log_notices.push_back({ logs.get_scope(), index, item, oldQuantity, newQuantity });
+#endif
+}
+
+#ifdef TRACELYTICS_LOG_NOTIFY
+void tracelytics::logbatch (const std::vector<InventoryLogNotice>& logs) {
+    require_auth( get_self() );
+}
+
+/**
+ * Sends the logs written by this action as a single notification
+ **/
+void tracelytics::send_log_notices () {
+    if (_log_notices.empty()) return;
+
+    tracelytics::logbatch_action logbatch_action( get_self(), {get_self(), "active"_n} );
+    logbatch_action.send(_log_notices);
+}
+#endif
+
+/**
+ * Partition (YYYYMM) of a log timestamp, from its UTC civil date
+ **/
+static uint64_t log_period (const time_point& timestamp) {
+    // Days since 1970-01-01 to year/month (H. Hinnant's civil_from_days)
+    int64_t days = timestamp.sec_since_epoch() / 86400;
+    days += 719468;
+    const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    const uint64_t doe = static_cast<uint64_t>(days - era * 146097);
+    const uint64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const uint64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const uint64_t mp = (5 * doy + 2) / 153;
+    const uint64_t month = mp < 10 ? mp + 3 : mp - 9;
+    const int64_t year = static_cast<int64_t>(yoe) + era * 400 + (month <= 2);
+
+    return static_cast<uint64_t>(year) * 100 + month;
+}
+
+/**
+ * Log table scoped to the partition of `timestamp`, registered in the directory on first use.
+ * The open partition is kept for the action, so consecutive rows reuse the table object.
+ *
+ * Timestamps come from clients, so rows may land in a partition rolluplog has already passed,
+ * or in one it emptied and dropped (whose keys then start over). The rollup cursor is moved
+ * back to the start of such a partition.
+ **/
+tracelytics::inventory_log_table& tracelytics::log_partition (const time_point& timestamp) {
+    const uint64_t period = log_period(timestamp);
+    if (_inventory_logs && _inventory_logs->get_scope() == period) return *_inventory_logs;
+
+    bool created = false;
+    if (_log_partitions.find(period) == _log_partitions.end()) {
+        _log_partitions.emplace(get_self(), [&](auto& p) {
+            p.period    = period;
+            p.createdAt = current_time_point();
+        });
+        created = true;
+    }
+
+    auto cursor = _rollup_cursor.find(0);
+    if (cursor != _rollup_cursor.end() && (period < cursor->period || (created && period == cursor->period))) {
+        _rollup_cursor.modify(cursor, get_self(), [&](auto& c) {
+            c.period = period;
+            c.next   = 0;
+        });
+    }
+
+    _inventory_logs.emplace(get_self(), period);
+    return *_inventory_logs;
+}
+
+/**
+ * Drop log rows of a partition, oldest first
+ **/
+void tracelytics::droplogs (const uint64_t& period, const uint32_t& max_rows) {
+    require_auth( get_self() );
+
+    auto partition = _log_partitions.find(period);
+    check(partition != _log_partitions.end(), "log partition does not exist");
+    check(max_rows > 0, "max_rows must be positive");
+
+    uint32_t dropped = cleanTable<inventory_log_table>(period, max_rows);
+    if (dropped == max_rows) return;
+
+    // Empty: drop the partition with its transactions and key counters, and the rollup cursor
+    // if it points into it
+    if (clear_partition(period, max_rows - dropped) == max_rows - dropped) return;
+    _log_partitions.erase(partition);
+
+    auto cursor = _rollup_cursor.find(0);
+    if (cursor != _rollup_cursor.end() && cursor->period == period) {
+        _rollup_cursor.erase(cursor);
+    }
+}
+
+/**
+ * Roll up log rows older than cutoff into daily totals per (company, site, product)
+ *
+ * Partitions are walked oldest first. Those before the cutoff month are rolled up whole;
+ * in the cutoff month itself newer rows are skipped. Every row examined counts against
+ * max_rows, and the cursor records the next one, so a backlog is worked off over several
+ * calls. Calling with a later cutoff rescans the cursor's partition from its first row.
+ **/
+void tracelytics::rolluplog (const time_point& cutoff, const uint32_t& max_rows) {
+    require_auth( get_self() );
+    check(max_rows > 0, "max_rows must be positive");
+
+    uint64_t period = 0;
+    uint64_t next   = 0;
+    auto cursor = _rollup_cursor.find(0);
+    if (cursor != _rollup_cursor.end()) {
+        period = cursor->period;
+        if (cursor->cutoff == cutoff) next = cursor->next;
+    }
+
+    // Totals of this call, written once per group below
+    std::map<std::tuple<uint64_t, uint64_t, uint64_t, uint64_t>, LogRollup> totals;
+
+    const uint64_t last = log_period(cutoff);
+    uint32_t rows = 0;
+    auto partition = _log_partitions.lower_bound(period);
+    while (partition != _log_partitions.end() && partition->period <= last && rows < max_rows) {
+        inventory_log_table logs(get_self(), partition->period);
+        auto log = logs.lower_bound(partition->period == period ? next : 0);
+        for (; log != logs.end() && rows < max_rows; ++rows) {
+            if (log->timestamp >= cutoff) {
+                ++log;
+                continue;
+            }
 
-        // TX ID
+            const uint64_t day = log->timestamp.sec_since_epoch() / 86400;
+            auto [total, added] = totals.try_emplace({ day, log->company, log->site, log->product });
+            auto& t = total->second;
+            if (added) {
+                t.day         = time_point(seconds(day * 86400));
+                t.company     = log->company;
+                t.site        = log->site;
+                t.product     = log->product;
+                t.totalDelta  = 0;
+                t.count       = 0;
+                t.minQuantity = log->newQuantity;
+                t.maxQuantity = log->newQuantity;
+            }
+            t.totalDelta  += log->delta;
+            t.count       += 1;
+            t.minQuantity  = std::min(t.minQuantity, log->newQuantity);
+            t.maxQuantity  = std::max(t.maxQuantity, log->newQuantity);
+
+            log = logs.erase(log);
+        }
+
+        period = partition->period;
+        if (log != logs.end()) {
+            next = log->index;
+            break;
+        }
+
+        // Scanned to the end: rows logged later into this partition get the following keys
+        next = logs.available_primary_key();
+        if (logs.begin() != logs.end()) {
+            ++partition;
+            continue;
+        }
+
+        // Emptied: drop it with its transactions and key counters
+        if (rows == max_rows || clear_partition(partition->period, max_rows - rows) == max_rows - rows) {
+            next = 0;
+            break;
+        }
+        partition = _log_partitions.erase(partition);
+    }
+
+    auto rollups_bydaygroup = _log_rollups.get_index<eosio::name("bydaygroup")>();
+    for (const auto& [group, t] : totals) {
+        auto rollup = Key::find_by_key(rollups_bydaygroup, t.by_day_group(), [&](const auto& row) {
+            return row.day == t.day && row.company == t.company && row.site == t.site && row.product == t.product;
+        });
+
+        if (rollup == rollups_bydaygroup.end()) {
+            _log_rollups.emplace(get_self(), [&](auto& r) {
+                r       = t;
+                r.index = next_index(_log_rollups);
+            });
+        } else {
+            rollups_bydaygroup.modify(rollup, get_self(), [&](auto& r) {
+                r.totalDelta  += t.totalDelta;
+                r.count       += t.count;
+                r.minQuantity  = std::min(r.minQuantity, t.minQuantity);
+                r.maxQuantity  = std::max(r.maxQuantity, t.maxQuantity);
+            });
+        }
+    }
+
+    if (cursor == _rollup_cursor.end()) {
+        _rollup_cursor.emplace(get_self(), [&](auto& c) {
+            c.cutoff = cutoff;
+            c.period = period;
+            c.next   = next;
+        });
+    } else {
+        _rollup_cursor.modify(cursor, get_self(), [&](auto& c) {
+            c.cutoff = cutoff;
+            c.period = period;
+            c.next   = next;
+        });
+    }
+}
+
+/**
+ * Clear log partitions, oldest first, and remove them from the directory once empty.
+ * Erases up to max_rows rows (a partition's directory entry counts as one).
+ **/
+uint32_t tracelytics::clear_logs (uint32_t max_rows) {
+    uint32_t rows = 0;
+    for (auto partition = _log_partitions.begin(); partition != _log_partitions.end() && rows < max_rows; ) {
+        uint32_t budget = max_rows - rows;
+        uint32_t erased = cleanTable<inventory_log_table>(partition->period, budget);
+        rows += erased;
+        if (erased == budget) break;
+
+        budget = max_rows - rows;
+        erased = clear_partition(partition->period, budget);
+        rows += erased;
+        if (erased == budget) break;
+
+        partition = _log_partitions.erase(partition);
+        ++rows;
+    }
+    return rows;
+}
+
+/**
+ * Erase the log rows of one company (symbol handle), partition by partition from job.scope.
+ * Walks the bycompany index where the profile builds it, and scans from job.cursor otherwise.
+ * Each partition visited and each row examined is a step.
+ **/
+uint32_t tracelytics::purge_logs (uint64_t company, Job& job, uint32_t max_rows) {
+    uint32_t rows = 0;
+    auto partition = _log_partitions.lower_bound(job.scope);
+    while (partition != _log_partitions.end() && rows < max_rows) {
+        ++rows;
+        job.scope = partition->period;
+        inventory_log_table logs(get_self(), partition->period);
+        auto matches = [&](const auto& row) { return row.company == company; };
+
+#if defined(TRACELYTICS_INDEXES_MINIMAL)
+        rows += purge_scan(logs, job.cursor, matches, max_rows - rows);
+#else
+        auto logs_bycompany = logs.get_index<eosio::name("bycompany")>();
+        rows += purge_key(logs_bycompany, Key::pack(company), job.cursor, matches, max_rows - rows);
+#endif
+        if (rows == max_rows) break;
+
+        // Partition done
+        job.cursor = 0;
+        if (logs.begin() == logs.end()) {
+            uint32_t budget = max_rows - rows;
+            rows += clear_partition(partition->period, budget);
+            if (rows == max_rows) break;
+            partition = _log_partitions.erase(partition);
+        } else {
+            ++partition;
+        }
+        if (partition != _log_partitions.end()) job.scope = partition->period;
+    }
+    return rows;
+}
+
+/**
+ * Erase what an emptied partition leaves behind, its transactions and key counters, up to
+ * max_rows rows. Returns the rows erased, fewer than max_rows once none are left. Keys and
+ * transaction rows this action cached for the partition are forgotten, so they are not
+ * written back.
+ **/
+uint32_t tracelytics::clear_partition (uint64_t period, uint32_t max_rows) {
+    uint32_t rows = cleanTable<transaction_table>(period, max_rows);
+    if (rows < max_rows) rows += cleanTable<counter_table>(period, max_rows - rows);
+
+    _transactions.erase(period);
+    for (auto counter = _next_indexes.begin(); counter != _next_indexes.end(); ) {
+        counter = counter->first.second == period ? _next_indexes.erase(counter) : std::next(counter);
+    }
+    return rows;
+}
+
+/**
+ * Row of the current transaction in the transaction table of a partition, created on first use.
+ * The transaction is read and hashed at most once per action, however many rows it logs.
+ **/
+uint64_t tracelytics::transaction_index (uint64_t period) {
+    auto cached = _transactions.find(period);
+    if (cached != _transactions.end()) return cached->second;
+
+    if (!_txid) {
         auto size = transaction_size();
-        char buf[size];
-        uint32_t read = read_transaction( buf, size );
+        std::vector<char> buf(size);
+        uint32_t read = read_transaction( buf.data(), size );
         check( size == read, "read_transaction failed");
-        i.txid = sha256(buf, size);
-    });
+        _txid = sha256(buf.data(), size);
+    }
+
+    // Earlier actions of the same transaction may have created it already
+    transaction_table transactions(get_self(), period);
+    auto transactions_bytxid = transactions.get_index<eosio::name("bytxid")>();
+    auto existing = transactions_bytxid.find(*_txid);
+
+    uint64_t index;
+    if (existing != transactions_bytxid.end()) {
+        index = existing->index;
+    } else {
+        index = next_index(transactions);
+        transactions.emplace(get_self(), [&](auto& t) {
+            t.index     = index;
+            t.txid      = *_txid;
+            t.createdAt = current_time_point();
+        });
+    }
+
+    _transactions.emplace(period, index);
+    return index;
+}
+
+/**
+ * Maps a string ID to its dense handle in the symbol table, adding it on first use.
+ * The empty string is always handle 0 and is never stored.
+ **/
+uint64_t tracelytics::intern (const std::string& value) {
+    if (value.empty()) return 0;
+
+    auto interned = _interned.find(value);
+    if (interned != _interned.end()) return interned->second;
+
+    auto symbols_byvalue = _symbols.get_index<eosio::name("byvalue")>();
+    auto symbol = Key::find_by_key(symbols_byvalue, Key::hash(value), [&](const auto& row) { return row.value == value; });
+
+    uint64_t handle;
+    if (symbol != symbols_byvalue.end()) {
+        handle = symbol->index;
+    } else {
+        handle = next_index(_symbols, 1);
+        check(handle < (1ull << 32), "symbol table is full");
+        _symbols.emplace(get_self(), [&](auto& s) {
+            s.index = handle;
+            s.value = value;
+        });
+    }
+
+    _interned.emplace(value, handle);
+    return handle;
 }
@@ -29,12 +29,12 @@ void tracelytics::newmachine (
 
     // Access table and make sure machine doesnt exist
     auto machines_bycompandid = _machines.get_index<eosio::name("bycompandid")>();
-    auto machine = machines_bycompandid.find(Checksum::MACHINE(company, machineId));
+    auto machine = Key::find_by_key(machines_bycompandid, Key::MACHINE(company, machineId), [&](const auto& row) { return row.company == company && row.machineId == machineId; });
     check(machine == machines_bycompandid.end(), "machine already exists");
 
     // Create new machine
     _machines.emplace(get_self(), [&](auto& m) {
-        m.index      = _machines.available_primary_key();
+        m.index      = next_index(_machines);
         m.createdBy  = user;
         m.updatedBy  = user;
         m.createdAt  = timestamp;
@@ -82,7 +82,7 @@ void tracelytics::editmachine (
 
     // Access table and make sure machine exists
     auto machines_bycompandid = _machines.get_index<eosio::name("bycompandid")>();
-    auto machine = machines_bycompandid.find(Checksum::MACHINE(company, machineId));
+    auto machine = Key::find_by_key(machines_bycompandid, Key::MACHINE(company, machineId), [&](const auto& row) { return row.company == company && row.machineId == machineId; });
     check(machine != machines_bycompandid.end(), "machine does not exist.");
     check(machineId == machine->machineId, "machine mismatch");
 
@@ -122,7 +122,7 @@ void tracelytics::delmachine (
 
     // Access table and make sure machine exists
     auto machines_bycompandid = _machines.get_index<eosio::name("bycompandid")>();
-    auto machine = machines_bycompandid.find(Checksum::MACHINE(company, machineId));
+    auto machine = Key::find_by_key(machines_bycompandid, Key::MACHINE(company, machineId), [&](const auto& row) { return row.company == company && row.machineId == machineId; });
     check(machine != machines_bycompandid.end(), "machine does not exist.");
     check(machineId == machine->machineId, "machine mismatch");
 
@@ -10,8 +10,8 @@ void tracelytics::newprocess (
     const std::string& type,
     const std::string& site,
     const time_point& startTime,
-    const std::map<std::string, ProductQuantity>& inputs,
-    const std::map<std::string, ProductQuantity>& outputs,
+    const CargoLines& inputs,
+    const CargoLines& outputs,
     const time_point& timestamp,
     const std::map<std::string, std::string>& data,
 
@@ -37,12 +37,12 @@ void tracelytics::newprocess (
 
     // Access table and make sure process doesnt exist
     auto processes_bycompandid = _processes.get_index<eosio::name("bycompandid")>();
-    auto process = processes_bycompandid.find(Checksum::PROCESS(company, processId));
+    auto process = Key::find_by_key(processes_bycompandid, Key::PROCESS(company, processId), [&](const auto& row) { return row.company == company && row.processId == processId; });
     check(process == processes_bycompandid.end(), "process already exists");
 
     // Create new process
     _processes.emplace(get_self(), [&](auto& b) {
-        b.index     = _processes.available_primary_key();
+        b.index     = next_index(_processes);
         b.createdBy = user;
         b.updatedBy = user;
         b.createdAt = timestamp;
@@ -50,27 +50,29 @@ void tracelytics::newprocess (
 
         b.company   = company;
         b.processId = processId;
-        b.type      = type;
+        b.set_type(type);
         b.site      = site;
         b.startTime = startTime;
 
         b.inputs    = inputs;
         b.outputs   = outputs;
+        Cargo::normalize(b.inputs);
+        Cargo::normalize(b.outputs);
 
         // Optional
         if (endTime)     b.endTime     = *endTime;
         if (machine)     b.machine     = *machine;
-        if (status)      b.status      = *status;
+        if (status)      b.set_status(*status);
         if (description) b.description = *description;
         if (version)     b.version     = *version;
 
         // New process, so we substract inputs from our site
-        std::map<std::string, ProductQuantity> emptyDeltas;
+        CargoLines emptyDeltas;
         processcargo(b, b.inputs, emptyDeltas, user, company, Actions::NEW_PROCESS, ProcessActivity::START_PROCESS);
 
         // Process immediately
-        if (type == ProcessType::SPLIT || type == ProcessType::MERGE || type == ProcessType::SCRAP || type == ProcessType::ADJUSTMENT) {
-            b.status = ProcessStatus::PROCESSED;
+        if (b.type == ProcessType::SPLIT || b.type == ProcessType::MERGE || b.type == ProcessType::SCRAP || b.type == ProcessType::ADJUSTMENT) {
+            b.set_status(ProcessStatus::PROCESSED);
             if (!endTime) {
                 b.endTime = timestamp;
             }
@@ -90,8 +92,8 @@ void tracelytics::editprocess (
     const std::string& user,
     const std::string& company,
     const std::string& processId,
-    const std::map<std::string, ProductQuantity>& inputDeltas,
-    const std::map<std::string, ProductQuantity>& outputDeltas,
+    CargoLines& inputDeltas,
+    CargoLines& outputDeltas,
     const time_point& timestamp,
     const std::map<std::string, std::string>& data,
 
@@ -109,10 +111,12 @@ void tracelytics::editprocess (
     check(!user.empty(),      "user is missing.");
     check(!company.empty(),   "company is missing.");
     check(!processId.empty(), "process ID is missing.");
+    Cargo::normalize(inputDeltas);
+    Cargo::normalize(outputDeltas);
 
     // Access table and make sure process doesnt exist
     auto processes_bycompandid = _processes.get_index<eosio::name("bycompandid")>();
-    auto process = processes_bycompandid.find(Checksum::PROCESS(company, processId));
+    auto process = Key::find_by_key(processes_bycompandid, Key::PROCESS(company, processId), [&](const auto& row) { return row.company == company && row.processId == processId; });
     check(process != processes_bycompandid.end(), "process does not exist.");
     check(processId == process->processId, "process mismatch");
 
@@ -128,13 +132,13 @@ void tracelytics::editprocess (
         b.updatedAt = timestamp;
 
         // Checks: 1) New status is PROCESSED and old status is not PROCESSED
-        bool justProcessed = status.value_or("") == ProcessStatus::PROCESSED && b.status != ProcessStatus::PROCESSED;
+        bool justProcessed = status && ProcessStatus::parse(*status) == ProcessStatus::PROCESSED && b.status != ProcessStatus::PROCESSED;
 
         // Optional
         if (startTime)   b.startTime   = *startTime;
         if (endTime)     b.endTime     = *endTime;
         if (machine)     b.machine     = *machine;
-        if (status)      b.status      = *status;
+        if (status)      b.set_status(*status);
         if (description) b.description = *description;
         if (version)     b.version     = *version;
 
@@ -148,7 +152,7 @@ void tracelytics::editprocess (
 
         // Update inventory if processed
         if (justProcessed) {
-          std::map<std::string, ProductQuantity> emptyDeltas;
+          CargoLines emptyDeltas;
           processcargo(b, b.outputs, emptyDeltas, user, company, Actions::EDIT_PROCESS, ProcessActivity::FINISH_PROCESS);
         }
     });
@@ -174,7 +178,7 @@ void tracelytics::delprocess (
 
     // Access table and make sure process doesnt exist
     auto processes_bycompandid = _processes.get_index<eosio::name("bycompandid")>();
-    auto process = processes_bycompandid.find(Checksum::PROCESS(company, processId));
+    auto process = Key::find_by_key(processes_bycompandid, Key::PROCESS(company, processId), [&](const auto& row) { return row.company == company && row.processId == processId; });
     check(process != processes_bycompandid.end(), "process does not exist.");
     check(processId == process->processId, "process mismatch");
 
@@ -189,12 +193,11 @@ void tracelytics::delprocess (
         processes_bycompandid.modify(process, get_self(), [&](auto& b) {
             b.updatedBy = user;
             b.updatedAt = timestamp;
-            b.status = ProcessStatus::CANCELLED;
-
-            // Refund
-            std::map<std::string, ProductQuantity> emptyDeltas;
-            processcargo(b, b.inputs, emptyDeltas, user, company, Actions::EDIT_PROCESS, ProcessActivity::FINISH_PROCESS);
+            b.set_status(ProcessStatus::CANCELLED);
         });
+
+        // Refund (as a job, the inputs may not fit this transaction)
+        start_job(JobType::CANCEL_PROCESS, process->index, timestamp);
     } else {
         processes_bycompandid.erase(process);
     }
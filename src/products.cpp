@@ -32,12 +32,12 @@ void tracelytics::newproduct (
 
     // Access table and make sure product doesnt exist
     auto products_byid = _products.get_index<eosio::name("byid")>();
-    auto product = products_byid.find(Checksum::PRODUCT(productId));
+    auto product = Key::find_by_key(products_byid, Key::PRODUCT(productId), [&](const auto& row) { return row.productId == productId; });
     check(product == products_byid.end(), "product already exists");
 
     // Create new product
     _products.emplace(get_self(), [&](auto& p) {
-        p.index     = _products.available_primary_key();
+        p.index     = next_index(_products);
         p.createdBy = user;
         p.updatedBy = user;
         p.createdAt = timestamp;
@@ -84,7 +84,7 @@ void tracelytics::editproduct (
 
     // Access table and make sure product exists
     auto products_byid = _products.get_index<eosio::name("byid")>();
-    auto product = products_byid.find(Checksum::PRODUCT(productId));
+    auto product = Key::find_by_key(products_byid, Key::PRODUCT(productId), [&](const auto& row) { return row.productId == productId; });
     check(product != products_byid.end(), "product does not exist.");
     check(productId == product->productId, "product mismatch");
 
@@ -127,7 +127,7 @@ void tracelytics::delproduct (
 
     // Access table and make sure product exists
     auto products_byid = _products.get_index<eosio::name("byid")>();
-    auto product = products_byid.find(Checksum::PRODUCT(productId));
+    auto product = Key::find_by_key(products_byid, Key::PRODUCT(productId), [&](const auto& row) { return row.productId == productId; });
     check(product != products_byid.end(), "product does not exist.");
     check(productId == product->productId, "product mismatch");
     check(user == ADMIN || user == product->createdBy, "only the creator of product " + product->productId + " (" + product->createdBy + ") can delete the product.");
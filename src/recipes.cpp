@@ -28,12 +28,12 @@ void tracelytics::newrecipe (
 
     // Access table and make sure recipe doesnt exist
     auto recipes_bycompandid = _recipes.get_index<eosio::name("bycompandid")>();
-    auto recipe = recipes_bycompandid.find(Checksum::RECIPE(company, recipeId));
+    auto recipe = Key::find_by_key(recipes_bycompandid, Key::RECIPE(company, recipeId), [&](const auto& row) { return row.company == company && row.recipeId == recipeId; });
     check(recipe == recipes_bycompandid.end(), "recipe already exists");
 
     // Create new recipe
     _recipes.emplace(get_self(), [&](auto& r) {
-        r.index     = _recipes.available_primary_key();
+        r.index     = next_index(_recipes);
         r.createdBy = user;
         r.updatedBy = user;
         r.createdAt = timestamp;
@@ -79,7 +79,7 @@ void tracelytics::editrecipe (
 
     // Access table and make sure recipe exists
     auto recipes_bycompandid = _recipes.get_index<eosio::name("bycompandid")>();
-    auto recipe = recipes_bycompandid.find(Checksum::RECIPE(company, recipeId));
+    auto recipe = Key::find_by_key(recipes_bycompandid, Key::RECIPE(company, recipeId), [&](const auto& row) { return row.company == company && row.recipeId == recipeId; });
     check(recipe != recipes_bycompandid.end(), "recipe does not exist.");
     check(recipeId == recipe->recipeId, "recipe mismatch");
 
@@ -121,7 +121,7 @@ void tracelytics::delrecipe (
 
     // Access table and make sure recipe exists
     auto recipes_bycompandid = _recipes.get_index<eosio::name("bycompandid")>();
-    auto recipe = recipes_bycompandid.find(Checksum::RECIPE(company, recipeId));
+    auto recipe = Key::find_by_key(recipes_bycompandid, Key::RECIPE(company, recipeId), [&](const auto& row) { return row.company == company && row.recipeId == recipeId; });
     check(recipe != recipes_bycompandid.end(), "recipe does not exist.");
     check(recipeId == recipe->recipeId, "recipe mismatch");
 
@@ -30,17 +30,17 @@ void tracelytics::newsite (
 
     // Access table and make sure site does NOT EXIST
     auto sites_byid = _sites.get_index<eosio::name("byid")>();
-    auto site = sites_byid.find(Checksum::SITE(siteId));
+    auto site = Key::find_by_key(sites_byid, Key::SITE(siteId), [&](const auto& row) { return row.siteId == siteId; });
     check(site == sites_byid.end(), "site already exists");
 
     // Access table and make sure company EXISTS
     auto companies_byid = _companies.get_index<eosio::name("byid")>();
-    auto company_itr = companies_byid.find(Checksum::COMPANY(siteCompany));
+    auto company_itr = Key::find_by_key(companies_byid, Key::COMPANY(siteCompany), [&](const auto& row) { return row.companyId == siteCompany; });
     check(company_itr != companies_byid.end(), "company " + siteCompany + " does not exist");
 
     // Create new site
     _sites.emplace(get_self(), [&](auto& s) {
-        s.index     = _sites.available_primary_key();
+        s.index     = next_index(_sites);
         s.createdBy = user;
         s.updatedBy = user;
         s.createdAt = timestamp;
@@ -86,7 +86,7 @@ void tracelytics::editsite (
 
     // Access table and make sure site exists
     auto sites_byid = _sites.get_index<eosio::name("byid")>();
-    auto site = sites_byid.find(Checksum::SITE(siteId));
+    auto site = Key::find_by_key(sites_byid, Key::SITE(siteId), [&](const auto& row) { return row.siteId == siteId; });
     check(site != sites_byid.end(), "site does not exist.");
     check(siteId == site->siteId, "site mismatch");
 
@@ -128,7 +128,7 @@ void tracelytics::delsite (
 
     // Access table and make sure site exists
     auto sites_byid = _sites.get_index<eosio::name("byid")>();
-    auto site = sites_byid.find(Checksum::SITE(siteId));
+    auto site = Key::find_by_key(sites_byid, Key::SITE(siteId), [&](const auto& row) { return row.siteId == siteId; });
     check(site != sites_byid.end(), "site does not exist.");
     check(siteId == site->siteId, "site mismatch");
 
@@ -140,10 +140,18 @@ void tracelytics::delsite (
     sites_byid.erase(site);
 }
 
-tracelytics::Site tracelytics::check_site_exists (const std::string& company, const std::string& site) {
-    auto sites_byid = _sites.get_index<eosio::name("byid")>();
-    auto site_itr = sites_byid.find(Checksum::SITE(site));
-    check(site_itr != sites_byid.end(), "Site " + site + " does not exist.");
-    check(site_itr->company == company, "Company " + company + " does not have site " + site);
-    return *site_itr;
+/**
+ * Site `site` of `company`; each site is looked up once per action
+ **/
+const tracelytics::Site& tracelytics::check_site_exists (const std::string& company, const std::string& site) {
+    auto loaded = _loaded_sites.find(site);
+    if (loaded == _loaded_sites.end()) {
+        auto sites_byid = _sites.get_index<eosio::name("byid")>();
+        auto site_itr = Key::find_by_key(sites_byid, Key::SITE(site), [&](const auto& row) { return row.siteId == site; });
+        check(site_itr != sites_byid.end(), "Site " + site + " does not exist.");
+        loaded = _loaded_sites.emplace(site, *site_itr).first;
+    }
+
+    check(loaded->second.company == company, "Company " + company + " does not have site " + site);
+    return loaded->second;
 }
@@ -23,4 +23,36 @@ void tracelytics::push(
         // tracelytics::remove_action r_action( get_self(), {get_self(), eosio::name("active")} );
         // r_action.send(username, company, entity, args);
     }
-}
\ No newline at end of file
+}
+/**
+ * End of action
+ **/
+tracelytics::~tracelytics() {
+    save_balances();
+    save_indexes();
+#ifdef TRACELYTICS_LOG_NOTIFY
+    send_log_notices();
+#endif
+}
+
+/**
+ * Save the primary key counters advanced by this action
+ **/
+void tracelytics::save_indexes() {
+    for (const auto& [table, counter] : _next_indexes) {
+        if (counter.next == counter.stored) continue;
+
+        counter_table counters(get_self(), table.second);
+        auto row = counters.find(table.first);
+        if (row == counters.end()) {
+            counters.emplace(get_self(), [&](auto& c) {
+                c.table = table.first;
+                c.next  = counter.next;
+            });
+        } else {
+            counters.modify(row, get_self(), [&](auto& c) {
+                c.next = counter.next;
+            });
+        }
+    }
+}
@@ -30,12 +30,12 @@ void tracelytics::newuser (
 
     // Access table and make sure user doesnt exist
     auto users_byid = _users.get_index<eosio::name("byid")>();
-    auto existing_user = users_byid.find(Checksum::USER(userId));
+    auto existing_user = Key::find_by_key(users_byid, Key::USER(userId), [&](const auto& row) { return row.userId == userId; });
     check(existing_user == users_byid.end(), "user already exists");
 
     // Create new user
     _users.emplace(get_self(), [&](auto& u) {
-        u.index          = _users.available_primary_key();
+        u.index          = next_index(_users);
         u.createdBy      = user;
         u.updatedBy      = user;
         u.createdAt      = timestamp;
@@ -86,7 +86,7 @@ void tracelytics::edituser (
 
     // Access table and make sure user exists
     auto users_byid = _users.get_index<eosio::name("byid")>();
-    auto existing_user = users_byid.find(Checksum::USER(userId));
+    auto existing_user = Key::find_by_key(users_byid, Key::USER(userId), [&](const auto& row) { return row.userId == userId; });
     check(existing_user != users_byid.end(), "user does not exist.");
     check(userId == existing_user->userId, "user mismatch");
 
@@ -131,7 +131,7 @@ void tracelytics::deluser (
 
     // Access table and make sure user exists
     auto users_byid = _users.get_index<eosio::name("byid")>();
-    auto existing_user = users_byid.find(Checksum::USER(userId));
+    auto existing_user = Key::find_by_key(users_byid, Key::USER(userId), [&](const auto& row) { return row.userId == userId; });
     check(existing_user != users_byid.end(), "user does not exist.");
     check(userId == existing_user->userId, "user mismatch");
 
@@ -1,30 +1,200 @@
 #include "tracelytics/tracelytics.hpp"
 
-void tracelytics::cleartable (const std::string& tableName) {
+// Tables cleartable takes, each cleared with the tables that belong to it (see clear_stages)
+static constexpr std::string_view CLEARABLE_TABLES[] = {
+  "inventorylog", "item", "company", "delivery", "machine", "process", "product", "recipe", "site", "user"
+};
+
+void tracelytics::cleartable (const std::string& tableName, const uint32_t& max_rows) {
   require_auth(get_self());
+  check(std::find(std::begin(CLEARABLE_TABLES), std::end(CLEARABLE_TABLES), tableName) != std::end(CLEARABLE_TABLES), "unknown table " + tableName);
+  check(max_rows > 0, "max_rows must be positive");
 
-  if (tableName == "inventorylog") {
-    cleanTable<inventory_log_table>();
-  } else if (tableName == "item") {
-    cleanTable<item_table>();
-  } else if (tableName == "user") {
-    cleanTable<user_table>();
-  } else if (tableName == "site") {
-    cleanTable<site_table>();
-  }
+  start_job(JobType::CLEAR_TABLE, eosio::name(tableName).value, current_time_point(), max_rows);
+}
+
+void tracelytics::clearall (const uint32_t& max_rows) {
+  require_auth(get_self());
+  check(max_rows > 0, "max_rows must be positive");
+
+  start_job(JobType::CLEAR_ALL, 0, current_time_point(), max_rows);
 }
 
-void tracelytics::clearall () {
+void tracelytics::purgecompany (const std::string& company, const uint32_t& max_rows) {
   require_auth(get_self());
-  cleanTable<inventory_log_table>();
-  cleanTable<company_table>();
-  cleanTable<item_table>();
-  cleanTable<machine_table>();
-  cleanTable<product_table>();
-  cleanTable<site_table>();
-  cleanTable<user_table>();
-  cleanTable<delivery_table>();
-  cleanTable<process_table>();
+  check(!company.empty(), "company is missing.");
+  check(max_rows > 0, "max_rows must be positive");
+
+  start_job(JobType::PURGE_COMPANY, intern(company), current_time_point(), max_rows);
+}
+
+/**
+ * Stages of a clearing or purge job, in the order they run
+ **/
+std::vector<uint8_t> tracelytics::clear_stages (const Job& job) {
+  using namespace ClearStage;
+
+  if (job.type == JobType::CLEAR_ALL) {
+    return { LOGS, ROLLUPS, COMPANIES, ITEMS, BALANCES, IN_TRANSIT, MACHINES, PRODUCTS, RECIPES, SITES, USERS,
+             DELIVERIES, DELIVERY_LINES, PROCESSES, SYMBOLS, COUNTERS, JOBS };
+  }
+  if (job.type == JobType::PURGE_COMPANY) {
+    return { LOGS, ROLLUPS, DELIVERIES, ITEMS, BALANCES, IN_TRANSIT, PROCESSES, MACHINES, RECIPES, SITES, USERS, COMPANIES };
+  }
+
+  check(job.type == JobType::CLEAR_TABLE, "not a clearing job");
+  const eosio::name table(job.target);
+  if (table == eosio::name("inventorylog")) return { LOGS, ROLLUPS };
+  if (table == eosio::name("item"))         return { ITEMS, BALANCES, IN_TRANSIT };
+  if (table == eosio::name("company"))      return { COMPANIES };
+  if (table == eosio::name("delivery"))     return { DELIVERIES, DELIVERY_LINES };
+  if (table == eosio::name("machine"))      return { MACHINES };
+  if (table == eosio::name("process"))      return { PROCESSES };
+  if (table == eosio::name("product"))      return { PRODUCTS };
+  if (table == eosio::name("recipe"))       return { RECIPES };
+  if (table == eosio::name("site"))         return { SITES };
+  if (table == eosio::name("user"))         return { USERS };
+  check(false, "unknown table " + table.to_string());
+  return {};
+}
+
+uint32_t tracelytics::clear_stage (uint8_t stage, const Job& job, uint32_t max_rows) {
+  switch (stage) {
+    case ClearStage::LOGS:           return clear_logs(max_rows);
+    case ClearStage::COMPANIES:      return cleanTable<company_table>(max_rows);
+    case ClearStage::ITEMS:          return cleanTable<item_table>(max_rows);
+    case ClearStage::BALANCES:       return cleanTable<balance_table>(max_rows);
+    case ClearStage::IN_TRANSIT:     return cleanTable<in_transit_table>(max_rows);
+    case ClearStage::MACHINES:       return cleanTable<machine_table>(max_rows);
+    case ClearStage::PRODUCTS:       return cleanTable<product_table>(max_rows);
+    case ClearStage::RECIPES:        return cleanTable<recipe_table>(max_rows);
+    case ClearStage::SITES:          return cleanTable<site_table>(max_rows);
+    case ClearStage::USERS:          return cleanTable<user_table>(max_rows);
+    case ClearStage::DELIVERIES:     return cleanTable<delivery_table>(max_rows);
+    case ClearStage::DELIVERY_LINES: return cleanTable<delivery_line_table>(max_rows);
+    case ClearStage::PROCESSES:      return cleanTable<process_table>(max_rows);
+    case ClearStage::SYMBOLS:        return cleanTable<symbol_table>(max_rows);
+    case ClearStage::COUNTERS:
+      // Counters this action cached would be written back by save_indexes
+      _next_indexes.clear();
+      return cleanTable<counter_table>(max_rows);
+    case ClearStage::ROLLUPS: {
+      uint32_t rows = cleanTable<log_rollup_table>(max_rows);
+      return rows < max_rows ? rows + cleanTable<rollup_cursor_table>(max_rows - rows) : rows;
+    }
+    case ClearStage::JOBS: {
+      // Every job but the one clearing
+      uint32_t rows = 0;
+      for (auto itr = _jobs.begin(); itr != _jobs.end() && rows < max_rows; ) {
+        if (itr->index == job.index) {
+          ++itr;
+          continue;
+        }
+        itr = _jobs.erase(itr);
+        ++rows;
+      }
+      return rows;
+    }
+  }
+  check(false, "unknown clear stage");
+  return 0;
+}
+
+/**
+ * Erase one company's rows from a stage's table. Tables with a bycompany index are walked by
+ * key, the others scanned, both from job.cursor. In-transit rows ("from -> to") go if either side is
+ * the company, and so do deliveries, with their lines and the items still travelling on them.
+ **/
+uint32_t tracelytics::purge_stage (uint8_t stage, const std::string& company, Job& job, uint32_t max_rows) {
+  auto ofCompany = [&](const auto& row) { return row.company == company; };
+  const IndexKey key = Key::hash(company);
+
+  switch (stage) {
+    case ClearStage::LOGS:       return purge_logs(job.target, job, max_rows);
+    case ClearStage::ROLLUPS:    return purge_scan(_log_rollups, job.cursor, [&](const auto& row) { return row.company == job.target; }, max_rows);
+    case ClearStage::DELIVERIES: return purge_deliveries(company, job, max_rows);
+    case ClearStage::BALANCES:   return purge_scan(_balances, job.cursor, ofCompany, max_rows);
+    case ClearStage::IN_TRANSIT: {
+      const std::string from = company + " -> ";
+      const std::string to   = " -> " + company;
+      return purge_scan(_in_transit, job.cursor, [&](const auto& row) {
+        return row.company.compare(0, from.size(), from) == 0 ||
+               (row.company.size() >= to.size() && row.company.compare(row.company.size() - to.size(), to.size(), to) == 0);
+      }, max_rows);
+    }
+#if defined(TRACELYTICS_INDEXES_MINIMAL)
+    case ClearStage::ITEMS:      return purge_scan(_items, job.cursor, ofCompany, max_rows);
+    case ClearStage::PROCESSES:  return purge_scan(_processes, job.cursor, ofCompany, max_rows);
+#else
+    case ClearStage::ITEMS: {
+      auto items_bycompany = _items.get_index<eosio::name("bycompany")>();
+      return purge_key(items_bycompany, key, job.cursor, ofCompany, max_rows);
+    }
+    case ClearStage::PROCESSES: {
+      auto processes_bycompany = _processes.get_index<eosio::name("bycompany")>();
+      return purge_key(processes_bycompany, key, job.cursor, ofCompany, max_rows);
+    }
+#endif
+    case ClearStage::MACHINES: {
+      auto machines_bycompany = _machines.get_index<eosio::name("bycompany")>();
+      return purge_key(machines_bycompany, key, job.cursor, ofCompany, max_rows);
+    }
+    case ClearStage::RECIPES: {
+      auto recipes_bycompany = _recipes.get_index<eosio::name("bycompany")>();
+      return purge_key(recipes_bycompany, key, job.cursor, ofCompany, max_rows);
+    }
+    case ClearStage::SITES: {
+      auto sites_bycompany = _sites.get_index<eosio::name("bycompany")>();
+      return purge_key(sites_bycompany, key, job.cursor, ofCompany, max_rows);
+    }
+    case ClearStage::USERS: {
+      auto users_bycompany = _users.get_index<eosio::name("bycompany")>();
+      return purge_key(users_bycompany, key, job.cursor, ofCompany, max_rows);
+    }
+    case ClearStage::COMPANIES: {
+      auto companies_byid = _companies.get_index<eosio::name("byid")>();
+      return purge_key(companies_byid, Key::COMPANY(company), job.cursor, [&](const auto& row) { return row.companyId == company; }, max_rows);
+    }
+  }
+  check(false, "unknown purge stage");
+  return 0;
+}
+
+// Deliveries sent or received by the company, scanned from job.cursor. Each line is a step.
+// The items still travelling on them leave the in-transit balance, written before the
+// IN_TRANSIT stage can erase its rows.
+uint32_t tracelytics::purge_deliveries (const std::string& company, Job& job, uint32_t max_rows) {
+  auto items_byid = _items.get_index<eosio::name("byid")>();
+  auto lines = _delivery_lines.get_index<eosio::name("bydelivitem")>();
+
+  uint32_t rows = 0;
+  auto delivery = _deliveries.lower_bound(job.cursor);
+  while (delivery != _deliveries.end() && rows < max_rows) {
+    if (delivery->fromCompany != company && delivery->toCompany != company) {
+      ++delivery;
+      ++rows;
+      continue;
+    }
+
+    auto line = lines.lower_bound((uint128_t) delivery->index << 64);
+    for (; line != lines.end() && line->delivery == delivery->index && rows < max_rows; ++rows) {
+      const auto& itemId = line->itemId;
+      auto item = Key::find_by_key(items_byid, Key::ITEM(itemId), [&](const auto& row) { return row.itemId == itemId; });
+      if (item != items_byid.end() && item->delivery == delivery->deliveryId) {
+        track_balance(*item, -1);
+        items_byid.erase(item);
+      }
+      line = lines.erase(line);
+    }
+    if (line != lines.end() && line->delivery == delivery->index) break;
+
+    delivery = _deliveries.erase(delivery);
+    ++rows;
+  }
+
+  save_balances();
+  if (delivery != _deliveries.end()) job.cursor = delivery->index;
+  return rows;
 }
 
 void tracelytics::ec_verify(std::string data, const signature &sig, const public_key &pk) {
@@ -35,7 +205,7 @@ void tracelytics::ec_verify(std::string data, const signature &sig, const public
 
 void tracelytics::verify_auth(std::string company, std::string userId, std::string entity, std::string action, std::string verifydata) {
     auto users_byid = _users.get_index<eosio::name("byid")>();
-    auto user = users_byid.find(Checksum::USER(userId));
+    auto user = Key::find_by_key(users_byid, Key::USER(userId), [&](const auto& row) { return row.userId == userId; });
     check( user != users_byid.end(), "user does not exist" );
     check( user->nonce == std::stoull(verifydata), "incorrect nonce" );
     check( std::count(user->permissions.begin(), user->permissions.end(), entity + ";" + action), "invalid permissions");
@@ -73,22 +243,3 @@ std::string tracelytics::to_hex(const char* d, uint32_t s) {
   }
   return r;
 }
-
-uint64_t tracelytics::truncate_sha256_to_uint64(const checksum256& sha256) {
-  auto array = sha256.extract_as_byte_array();
-  uint64_t value =
-    static_cast<uint64_t>(array[0]) |
-    static_cast<uint64_t>(array[1]) << 8 |
-    static_cast<uint64_t>(array[2]) << 16 |
-    static_cast<uint64_t>(array[3]) << 24 |
-    static_cast<uint64_t>(array[4]) << 32 |
-    static_cast<uint64_t>(array[5]) << 40 |
-    static_cast<uint64_t>(array[6]) << 48 |
-    static_cast<uint64_t>(array[7]) << 56;
-
-  return value;
-}
-
-checksum256 tracelytics::SHA256(const std::string& stringToSha) {
-  return sha256(stringToSha.c_str(), stringToSha.size());
-}
@@ -43,17 +43,76 @@ export interface Delivery {
 	updatedBy  : string;
 	createdAt  : string;
 	updatedAt  : string;
-	cargo      : ProductQuantities;
 	data       : Array<any>;
 }
 
+// One cargo line of a delivery (delivery is Delivery.index)
+export interface Deliveryline {
+	index   : number;
+	delivery: number;
+	itemId  : string;
+	product : string;
+	quantity: number;
+	metadata: Metadata;
+}
+
+// Stored log row (scope: YYYYMM period). ID fields are symbol handles, 0 for empty.
 export interface Inventorylog {
+	index         : number;
+	user          : number;
+	company       : number;
+	item          : number;
+	site          : number;
+	product       : number;
+	delivery      : number;
+	action        : number;
+	parentAction  : number;
+	parentActionId: number;
+	timestamp     : string;
+	newQuantity   : number;
+	delta         : number;
+	transaction   : number;
+}
+
+export interface Symbol {
+	index: number;
+	value: string;
+}
+
+// Transaction that wrote log rows (scope: the rows' YYYYMM period, so transaction is only unique within it)
+export interface Transaction {
+	index    : number;
+	txid     : string;
+	createdAt: string;
+}
+
+// Work resumed by crank. type: 1 receive delivery, 2 cancel delivery, 3 cancel process (target is
+// the delivery or process index), 4 cleartable (target is the table name), 5 clearall,
+// 6 purgecompany (target is the company's symbol), 7 delete delivery (erases the lines of the deleted
+// delivery whose index is target). status: 1 pending, 2 done, 3 failed (crank it by index, or start
+// it again, to retry). Delivery jobs leave the delivery "receiving" or "cancelling" until done.
+export interface Job {
+	index    : number;
+	type     : number;
+	status   : number;
+	stage    : number;
+	target   : number;
+	scope    : number;
+	cursor   : number;
+	steps    : number;
+	createdAt: string;
+	updatedAt: string;
+}
+
+// Full view of a log row, with handles resolved
+export interface InventorylogView {
 	index         : number;
 	user          : string;
 	company       : string;
 	item          : string;
 	site          : string;
 	product       : string;
+	delivery      : string;
 	metadata      : Metadata;
 	action        : string;
 	parentAction  : string;
@@ -63,8 +122,47 @@ export interface Inventorylog {
 	newQuantity   : number;
 	delta         : number;
 	txid          : string;
-	version       : string;
-	data          : Array<any>;
+}
+
+// Rebuilds the full view of a log row; transactions are those of the row's partition. Metadata is the item's current metadata (empty once the item is deleted).
+export const inventorylogView = (log: Inventorylog, symbols: Map<number, string>, transactions: Map<number, string>, items: Map<string, Item>): InventorylogView => {
+	const symbol = (handle: number) => handle ? symbols.get(handle) || '' : '';
+	const item   = items.get(symbol(log.item));
+	return {
+		index         : log.index,
+		user          : symbol(log.user),
+		company       : symbol(log.company),
+		item          : symbol(log.item),
+		site          : symbol(log.site),
+		product       : symbol(log.product),
+		delivery      : symbol(log.delivery),
+		metadata      : item ? item.metadata : {},
+		action        : symbol(log.action),
+		parentAction  : symbol(log.parentAction),
+		parentActionId: symbol(log.parentActionId),
+		timestamp     : log.timestamp,
+		oldQuantity   : log.newQuantity - log.delta,
+		newQuantity   : log.newQuantity,
+		delta         : log.delta,
+		txid          : transactions.get(log.transaction) || '',
+	};
+}
+
+// Quantity of a product at a site
+export interface Balance {
+	index   : number;
+	company : string;
+	site    : string;
+	product : string;
+	quantity: number;
+}
+
+// Quantity of a product in transit between two companies ("from -> to")
+export interface Intransit {
+	index   : number;
+	company : string;
+	product : string;
+	quantity: number;
 }
 
 export interface Item {
@@ -204,7 +302,6 @@ export interface TracelyticsAbi extends Contract {
 	editrecipe   (data: { user: string, company: string, recipeId: string, inputs: Array<ProductQuantitySingle>, outputs: Array<ProductQuantitySingle>, timestamp: string, data: Array<any>, name: string, description: string, version: string })                                                                  : Promise<any>;
 	editsite     (data: { user: string, company: string, siteId: string, timestamp: string, data: Array<any>, name: string, description: string, version: string })                                                                                                                                                 : Promise<any>;
 	edituser     (data: { user: string, company: string, userId: string, permissions: Array<string>, certifications: Array<string>, timestamp: string, data: Array<any>, key: string, firstName: string, lastName: string, email: string, description: string, version: string })                                   : Promise<any>;
-	loginventory (data: { user: string, company: string, item: string, site: string, product: string, metadata:  Metadata, action: string, parentAction: string, parentActionId: string, timestamp: string, version: string, oldQuantity: number, newQuantity: number })                                            : Promise<any>;
 	newdelivery  (data: { user: string, company: string, deliveryId: string, type: string, fromSite: string, toSite: string, startTime: string, cargo: ProductQuantities, timestamp: string, data: Array<any>, endTime: string, shipper: string, driver: string, status: string, description: string, version: string }): Promise<any>;
 	newitem      (data: { user: string, company: string, site: string, itemId: string, product: string, quantity: number, metadata:  Metadata, action: string, actionId: string, timestamp: string, data: Array<any>, version: string })                                                                            : Promise<any>;
 	newmachine   (data: { user: string, company: string, machineId: string, site: string, timestamp: string, data: Array<any>, name: string, description: string, version: string })                                                                                                                                : Promise<any>;